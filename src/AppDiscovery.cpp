@@ -5,15 +5,27 @@
 #include <QStandardPaths>
 #include <QStringList>
 
+#include "AppScanner.h"
 #include "DbManager.h"
 
-AppDiscovery::AppDiscovery(DbManager *db)
+AppDiscovery::AppDiscovery(DbManager *db) : fullRescan(false)
 {
     dbman = db;
+    fingerprints.bindToDatabase(DbManager::localShareLaunchApplicationsPath);
 }
 
 AppDiscovery::~AppDiscovery() { }
 
+void AppDiscovery::setFullRescan(bool fullRescan)
+{
+    this->fullRescan = fullRescan;
+}
+
+bool AppDiscovery::saveFingerprints()
+{
+    return fingerprints.save();
+}
+
 QStringList AppDiscovery::wellKnownApplicationLocations()
 {
     QStringList wellKnownApplicationLocations = {};
@@ -47,49 +59,15 @@ void AppDiscovery::findAppsInside(QStringList locationsContainingApps)
 // TODO: Nested submenus rather than flat ones with '→'
 // This code is similar to the code in the 'launch' command
 {
-    QStringList nameFilter({ "*.app", "*.AppDir", "*.desktop", "*.AppImage", "*.appimage" });
-    foreach (QString directory, locationsContainingApps) {
-        // Shall we process this directory? Only if it contains at least one
-        // application, to optimize for speed by not descending into directory trees
-        // that do not contain any applications at all. Can make a big difference.
-
-        QDir dir(directory);
-        int numberOfAppsInDirectory = dir.entryList(nameFilter).length();
-
-        if (directory.endsWith(".app") == false && directory.endsWith(".AppDir") == false
-            && numberOfAppsInDirectory > 0) {
-        } else {
-            continue;
-        }
-
-        // Use QDir::entryList() insted of QDirIterator because it supports sorting
-        QStringList candidates = dir.entryList();
-        for (QString candidate : candidates) {
-            candidate = dir.path() + "/" + candidate;
-            // Do not show Autostart directories (or should we?)
-            if ((candidate.endsWith("/Autostart") == true) || (candidate.endsWith("/.") == true)
-                || (candidate.endsWith("/..") == true)) {
-                continue;
-            }
-            qDebug() << "Processing" << candidate;
-
-            if (candidate.endsWith(".app")) {
-                dbman->handleApplication(candidate);
-            } else if (candidate.endsWith(".AppDir")) {
-                dbman->handleApplication(candidate);
-            } else if (candidate.endsWith(".desktop")) {
-                dbman->handleApplication(candidate);
-            } else if (candidate.endsWith(".AppImage") || candidate.endsWith(".appimage")) {
-                dbman->handleApplication(candidate);
-            } else if (locationsContainingApps.contains(candidate) == false
-                       && QFileInfo(candidate).isDir() && candidate.endsWith("/..") == false
-                       && candidate.endsWith("/.") == false && candidate.endsWith(".app") == false
-                       && candidate.endsWith(".AppDir") == false) {
-                // qDebug() << "# Found" << file.fileName() << ", a directory that is
-                // not an .app bundle nor an .AppDir";
-                QStringList locationsToBeChecked({ candidate });
-                findAppsInside(locationsToBeChecked);
-            }
-        }
+    // The directory trees are scanned in parallel, but the launch database
+    // is only ever written to from this thread
+    AppScanner scanner(&fingerprints, fullRescan);
+    const QStringList candidates = scanner.scan(locationsContainingApps);
+    // Only the symlinks that are missing are created, all at once at the end
+    dbman->begin();
+    for (const QString &candidate : candidates) {
+        qDebug() << "Processing" << candidate;
+        dbman->handleApplication(candidate);
     }
+    dbman->commit();
 }
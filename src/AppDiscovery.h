@@ -4,6 +4,7 @@
 #include <QStringList>
 
 #include "DbManager.h"
+#include "DirectoryFingerprints.h"
 
 /**
  * @file AppDiscovery.h
@@ -38,15 +39,33 @@ public:
     /**
      * Find and process applications within specified locations.
      *
-     * This function searches for applications within the provided locations and
-     * handles each discovered application using the associated DbManager instance.
+     * This function searches for applications within the provided locations in
+     * parallel and handles each discovered application using the associated DbManager
+     * instance. Directories that are unchanged since they were last scanned are not
+     * listed again unless a full rescan has been requested.
      *
      * @param locationsContainingApps A list of locations to search for applications.
      */
     void findAppsInside(QStringList locationsContainingApps);
 
+    /**
+     * Request that all directories are scanned, regardless of their fingerprints.
+     *
+     * @param fullRescan True to ignore the stored directory fingerprints.
+     */
+    void setFullRescan(bool fullRescan);
+
+    /**
+     * Persist the directory fingerprints collected by findAppsInside().
+     *
+     * @return True on success.
+     */
+    bool saveFingerprints();
+
 private:
     DbManager *dbman; /**< A pointer to the DbManager instance. */
+    DirectoryFingerprints fingerprints; /**< Fingerprints of previously scanned directories. */
+    bool fullRescan; /**< Whether to ignore the fingerprints. */
 };
 
 #endif // APPDISCOVERY_H
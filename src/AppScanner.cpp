@@ -0,0 +1,150 @@
+#include "AppScanner.h"
+
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+
+// Scans one directory on a thread of the pool
+class ScanDirectoryTask : public QRunnable
+{
+public:
+    ScanDirectoryTask(AppScanner *scanner, const QString &directory)
+        : scanner(scanner), directory(directory)
+    {
+    }
+    void run() override { scanner->scanDirectory(directory); }
+
+private:
+    AppScanner *scanner;
+    QString directory;
+};
+
+static bool isApplication(const QString &path, Qt::CaseSensitivity cs)
+{
+    return path.endsWith(".app", cs) || path.endsWith(".AppDir", cs)
+            || path.endsWith(".desktop", cs) || path.endsWith(".AppImage", cs)
+            || path.endsWith(".appimage", cs);
+}
+
+AppScanner::AppScanner(DirectoryFingerprints *fingerprints, bool fullRescan)
+    : fingerprints(fingerprints), fullRescan(fullRescan)
+{
+    // Most of the time is spent waiting for the filesystem, especially on network
+    // home directories, so use more threads than there are cores
+    pool.setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+}
+
+AppScanner::~AppScanner()
+{
+    pool.waitForDone();
+}
+
+QStringList AppScanner::scan(const QStringList &locationsContainingApps)
+{
+    roots = locationsContainingApps;
+    for (const QString &directory : locationsContainingApps) {
+        enqueue(directory);
+    }
+    pool.waitForDone();
+
+    // Sort so that the database gets populated in the same order on every run,
+    // regardless of which thread finished first
+    QStringList sortedResults = results;
+    std::sort(sortedResults.begin(), sortedResults.end());
+    results.clear();
+    visited.clear();
+    return sortedResults;
+}
+
+void AppScanner::enqueue(const QString &directory)
+{
+    pool.start(new ScanDirectoryTask(this, directory));
+}
+
+void AppScanner::scanDirectory(const QString &directory)
+{
+    if (directory.endsWith(".app") || directory.endsWith(".AppDir")) {
+        return;
+    }
+
+    DirectoryFingerprint fingerprint;
+    if (!DirectoryFingerprints::currentFingerprint(directory, fingerprint)) {
+        return;
+    }
+
+    DirectoryFingerprint stored;
+    bool unchanged = false;
+    {
+        QMutexLocker locker(&mutex);
+        if (visited.contains(qMakePair(fingerprint.device, fingerprint.inode))) {
+            return;
+        }
+        visited.insert(qMakePair(fingerprint.device, fingerprint.inode));
+        unchanged = !fullRescan && fingerprints->isUnchanged(directory, fingerprint, stored);
+    }
+
+    // If no entries have been added to or removed from this directory since it was
+    // last scanned, there is nothing new in it; only its subdirectories need checking
+    if (unchanged) {
+        qDebug() << "Skipping unchanged" << directory << "with" << stored.entryCount
+                 << "applications";
+        for (const QString &subdirectory : qAsConst(stored.subdirectories)) {
+            enqueue(subdirectory);
+        }
+        return;
+    }
+
+    QStringList applications;
+    QStringList subdirectories;
+    fingerprint.entryCount = listDirectory(directory, roots, applications, subdirectories);
+    fingerprint.subdirectories = subdirectories;
+
+    {
+        QMutexLocker locker(&mutex);
+        results.append(applications);
+        fingerprints->update(directory, fingerprint);
+    }
+
+    for (const QString &subdirectory : qAsConst(subdirectories)) {
+        enqueue(subdirectory);
+    }
+}
+
+int AppScanner::listDirectory(const QString &directory, const QStringList &roots,
+                              QStringList &applications, QStringList &subdirectories)
+{
+    // List the directory only once; the type of each entry is known from the
+    // directory listing in most cases, so that no additional stat calls are needed
+    int entryCount = 0;
+    QDirIterator it(directory, QDir::AllEntries | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        QString candidate = it.next();
+        // Do not show Autostart directories (or should we?)
+        if (candidate.endsWith("/Autostart")) {
+            continue;
+        }
+        if (isApplication(candidate, Qt::CaseSensitive)) {
+            applications.append(candidate);
+            entryCount++;
+        } else if (isApplication(candidate, Qt::CaseInsensitive)) {
+            // Counts towards the applications in this directory, like
+            // QDir::entryList() name filters do, but is not handled
+            entryCount++;
+        } else if (!roots.contains(candidate) && it.fileInfo().isDir()) {
+            subdirectories.append(candidate);
+        }
+    }
+
+    // Shall we descend into the subdirectories? Only if this directory contains at least
+    // one application, to optimize for speed by not descending into directory trees
+    // that do not contain any applications at all. Can make a big difference.
+    if (entryCount == 0) {
+        subdirectories.clear();
+    }
+    return entryCount;
+}
@@ -0,0 +1,87 @@
+#ifndef APPSCANNER_H
+#define APPSCANNER_H
+
+#include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "DirectoryFingerprints.h"
+
+/**
+ * @file AppScanner.h
+ * @class AppScanner
+ * @brief Scans directory trees for applications using a pool of threads.
+ *
+ * Each directory is scanned by its own task; subdirectories found while scanning
+ * are queued as new tasks so that idle threads pick them up, which keeps all threads
+ * busy even if the directory trees are very unevenly sized. Directories are visited at
+ * most once, even if they can be reached through symlinks or are listed more than once.
+ *
+ * The scanner does not modify the launch database; it only collects the paths of the
+ * applications it finds so that they can be handled by a single writer.
+ */
+class AppScanner
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param fingerprints The fingerprints of previously scanned directories; updated
+     * during the scan.
+     * @param fullRescan True to scan directories even if their fingerprints are unchanged.
+     */
+    AppScanner(DirectoryFingerprints *fingerprints, bool fullRescan);
+
+    /**
+     * Destructor.
+     */
+    ~AppScanner();
+
+    /**
+     * Scan locations and their subdirectories for applications.
+     *
+     * Blocks until all directories have been scanned.
+     *
+     * @param locationsContainingApps The locations to search for applications.
+     * @return The paths of the applications found in changed directories, sorted.
+     */
+    QStringList scan(const QStringList &locationsContainingApps);
+
+    /**
+     * Scan a single directory and queue its subdirectories. Called from the worker threads.
+     */
+    void scanDirectory(const QString &directory);
+
+    /**
+     * List the applications and the subdirectories that may contain applications
+     * directly inside a directory, reading the directory only once.
+     *
+     * Subdirectories are only returned if the directory contains at least one
+     * application, because directory trees that do not contain any applications
+     * at their top level are not searched.
+     *
+     * @param directory The directory to list.
+     * @param roots Locations that are searched on their own and hence are not returned
+     * as subdirectories.
+     * @param applications Receives the applications found in the directory.
+     * @param subdirectories Receives the subdirectories to be searched.
+     * @return The number of applications in the directory.
+     */
+    static int listDirectory(const QString &directory, const QStringList &roots,
+                             QStringList &applications, QStringList &subdirectories);
+
+private:
+    void enqueue(const QString &directory);
+
+    DirectoryFingerprints *fingerprints;
+    bool fullRescan;
+    QStringList roots;
+    QThreadPool pool;
+    QMutex mutex; /**< Guards visited, results and fingerprints. */
+    QSet<QPair<quint64, quint64>> visited; /**< Device and inode of visited directories. */
+    QStringList results;
+};
+
+#endif // APPSCANNER_H
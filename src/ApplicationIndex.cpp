@@ -0,0 +1,514 @@
+#include "ApplicationIndex.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVersionNumber>
+
+#include <algorithm>
+#include <cstring>
+
+#include "DirectoryFingerprints.h"
+
+static const char INDEX_MAGIC[8] = { 'L', 'A', 'U', 'N', 'C', 'H', 'I', 'X' };
+static const quint32 INDEX_VERSION = 4;
+static const int FIELDS_PER_RECORD = 5;
+
+struct IndexHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 applicationCount;
+    qint64 applicationsMtimeNs;
+    quint64 applicationsDevice;
+    quint64 applicationsInode;
+    quint32 recordsOffset;
+    quint32 byPathOffset;
+    quint32 mimeTypeCount;
+    quint32 mimeTypesOffset;
+    quint32 mediaTypeCount;
+    quint32 mediaTypesOffset;
+    quint32 nameCount;
+    quint32 namesOffset;
+    quint32 listsOffset;
+    quint32 stringsOffset;
+    quint32 stringsSize;
+};
+
+ApplicationIndex::ApplicationIndex(const QString &indexPath)
+    : indexPath(indexPath),
+      data(nullptr),
+      size(0),
+      applicationCount(0),
+      recordsOffset(0),
+      byPathOffset(0),
+      mimeTypeCount(0),
+      mimeTypesOffset(0),
+      mediaTypeCount(0),
+      mediaTypesOffset(0),
+      nameCount(0),
+      namesOffset(0),
+      listsOffset(0),
+      stringsOffset(0)
+{
+}
+
+ApplicationIndex::~ApplicationIndex()
+{
+    close();
+}
+
+QString ApplicationIndex::defaultIndexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+            + "/launch/applications.index";
+}
+
+bool ApplicationIndex::open(const QString &applicationsPath)
+{
+    close();
+
+    DirectoryFingerprint current;
+    if (!DirectoryFingerprints::currentFingerprint(applicationsPath, current)) {
+        return false;
+    }
+
+    file.setFileName(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    size = file.size();
+    if (size < qint64(sizeof(IndexHeader))) {
+        file.close();
+        return false;
+    }
+    data = file.map(0, size);
+    if (!data) {
+        file.close();
+        return false;
+    }
+
+    IndexHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool ok = memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+            && header.version == INDEX_VERSION && header.recordsOffset >= sizeof(header)
+            && header.byPathOffset >= header.recordsOffset
+            && header.mimeTypesOffset >= header.byPathOffset
+            && header.mediaTypesOffset >= header.mimeTypesOffset
+            && header.namesOffset >= header.mediaTypesOffset
+            && header.listsOffset >= header.namesOffset
+            && header.stringsOffset >= header.listsOffset
+            && qint64(header.stringsOffset) + header.stringsSize == size
+            && header.stringsSize > 0 && data[size - 1] == 0
+            && qint64(header.applicationCount) * FIELDS_PER_RECORD * sizeof(quint32)
+                    <= header.byPathOffset - header.recordsOffset
+            && qint64(header.applicationCount) * sizeof(quint32)
+                    <= header.mimeTypesOffset - header.byPathOffset
+            && qint64(header.mimeTypeCount) * 2 * sizeof(quint32)
+                    <= header.mediaTypesOffset - header.mimeTypesOffset
+            && qint64(header.mediaTypeCount) * 2 * sizeof(quint32)
+                    <= header.namesOffset - header.mediaTypesOffset
+            && qint64(header.nameCount) * 2 * sizeof(quint32)
+                    <= header.listsOffset - header.namesOffset;
+    if (!ok) {
+        qDebug() << "Ignoring malformed application index" << indexPath;
+        close();
+        return false;
+    }
+
+    // The symlinks have been changed since the index was written
+    if (header.applicationsMtimeNs != current.mtimeNs
+        || header.applicationsDevice != current.device
+        || header.applicationsInode != current.inode) {
+        qDebug() << "Ignoring stale application index" << indexPath;
+        close();
+        return false;
+    }
+
+    applicationCount = header.applicationCount;
+    recordsOffset = header.recordsOffset;
+    byPathOffset = header.byPathOffset;
+    mimeTypeCount = header.mimeTypeCount;
+    mimeTypesOffset = header.mimeTypesOffset;
+    mediaTypeCount = header.mediaTypeCount;
+    mediaTypesOffset = header.mediaTypesOffset;
+    nameCount = header.nameCount;
+    namesOffset = header.namesOffset;
+    listsOffset = header.listsOffset;
+    stringsOffset = header.stringsOffset;
+    return true;
+}
+
+void ApplicationIndex::close()
+{
+    if (data) {
+        file.unmap(const_cast<uchar *>(data));
+        data = nullptr;
+    }
+    if (file.isOpen()) {
+        file.close();
+    }
+    size = 0;
+    applicationCount = 0;
+}
+
+bool ApplicationIndex::isOpen() const
+{
+    return data != nullptr;
+}
+
+int ApplicationIndex::count() const
+{
+    return int(applicationCount);
+}
+
+quint32 ApplicationIndex::field(int i, int f) const
+{
+    quint32 value;
+    memcpy(&value, data + recordsOffset + (i * FIELDS_PER_RECORD + f) * sizeof(quint32),
+           sizeof(value));
+    return value;
+}
+
+const char *ApplicationIndex::string(quint32 offset) const
+{
+    if (stringsOffset + qint64(offset) >= size) {
+        return "";
+    }
+    return reinterpret_cast<const char *>(data + stringsOffset + offset);
+}
+
+QString ApplicationIndex::path(int i) const
+{
+    return QString::fromUtf8(string(field(i, 0)));
+}
+
+QString ApplicationIndex::name(int i) const
+{
+    return QString::fromUtf8(string(field(i, 1)));
+}
+
+QString ApplicationIndex::suffix(int i) const
+{
+    return QString::fromUtf8(string(field(i, 2)));
+}
+
+QStringList ApplicationIndex::canOpen(int i) const
+{
+    QStringList mimeTypes = QString::fromUtf8(string(field(i, 3))).split(";");
+    mimeTypes.removeAll("");
+    return mimeTypes;
+}
+
+QStringList ApplicationIndex::links(int i) const
+{
+    return list(field(i, 4));
+}
+
+QStringList ApplicationIndex::list(quint32 listOffset) const
+{
+    QStringList results;
+    const qint64 listsEnd = stringsOffset;
+    qint64 position = listsOffset + qint64(listOffset) * sizeof(quint32);
+    if (position + qint64(sizeof(quint32)) > listsEnd) {
+        return results;
+    }
+    quint32 n;
+    memcpy(&n, data + position, sizeof(n));
+    position += sizeof(quint32);
+    if (position + qint64(n) * sizeof(quint32) > listsEnd) {
+        return results;
+    }
+    results.reserve(int(n));
+    for (quint32 j = 0; j < n; j++) {
+        quint32 offset;
+        memcpy(&offset, data + position + j * sizeof(quint32), sizeof(offset));
+        results.append(QString::fromUtf8(string(offset)));
+    }
+    return results;
+}
+
+// Binary search in a table of (key, list) pairs sorted by key
+QStringList ApplicationIndex::lookUp(quint32 tableOffset, quint32 tableCount,
+                                     const QString &key) const
+{
+    if (!isOpen()) {
+        return QStringList();
+    }
+    const QByteArray utf8 = key.toUtf8();
+    qint64 low = 0;
+    qint64 high = qint64(tableCount) - 1;
+    while (low <= high) {
+        qint64 middle = low + (high - low) / 2;
+        quint32 pair[2];
+        memcpy(pair, data + tableOffset + middle * sizeof(pair), sizeof(pair));
+        int comparison = strcmp(string(pair[0]), utf8.constData());
+        if (comparison == 0) {
+            return list(pair[1]);
+        } else if (comparison < 0) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return QStringList();
+}
+
+QStringList ApplicationIndex::handlersForMimeType(const QString &mimeType) const
+{
+    return lookUp(mimeTypesOffset, mimeTypeCount, mimeType);
+}
+
+QStringList ApplicationIndex::handlersForMediaType(const QString &mediaType) const
+{
+    return lookUp(mediaTypesOffset, mediaTypeCount, mediaType);
+}
+
+QStringList ApplicationIndex::applicationsForName(const QString &name) const
+{
+    return lookUp(namesOffset, nameCount, name);
+}
+
+QStringList ApplicationIndex::nameKeys(const QString &name)
+{
+    QStringList keys = { name };
+
+    // "FeatherPad-1.2.3-x86_64" can be launched as "FeatherPad"
+    static const QRegularExpression versioned("^(.+?)-\\d");
+    QRegularExpressionMatch match = versioned.match(name);
+    if (match.hasMatch()) {
+        keys.append(match.captured(1));
+    }
+
+    // "org.kde.kate" can be launched as "kate"
+    int lastDot = name.lastIndexOf('.');
+    if (lastDot > 0 && lastDot < name.size() - 1 && !name.at(lastDot + 1).isDigit()) {
+        keys.append(name.mid(lastDot + 1));
+    }
+
+    keys.removeDuplicates();
+    return keys;
+}
+
+// Lower is preferred when several applications have the same name
+static int suffixRank(const QString &suffix)
+{
+    static const QStringList preferredSuffixes = { "app", "AppDir", "AppImage", "desktop" };
+    for (int i = 0; i < preferredSuffixes.size(); i++) {
+        if (suffix.compare(preferredSuffixes[i], Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return preferredSuffixes.size();
+}
+
+static QVersionNumber versionOf(const QString &name)
+{
+    static const QRegularExpression versionStart("-\\d");
+    int dash = name.indexOf(versionStart);
+    if (dash == -1) {
+        return QVersionNumber();
+    }
+    return QVersionNumber::fromString(name.mid(dash + 1));
+}
+
+QStringList ApplicationIndex::paths() const
+{
+    QStringList results;
+    results.reserve(count());
+    for (int i = 0; i < count(); i++) {
+        results.append(path(i));
+    }
+    return results;
+}
+
+int ApplicationIndex::find(const QString &path) const
+{
+    const QByteArray key = path.toUtf8();
+    int low = 0;
+    int high = count() - 1;
+    while (low <= high) {
+        int middle = low + (high - low) / 2;
+        quint32 record;
+        memcpy(&record, data + byPathOffset + middle * sizeof(quint32), sizeof(record));
+        if (record >= applicationCount) {
+            return -1;
+        }
+        int comparison = strcmp(string(field(record, 0)), key.constData());
+        if (comparison == 0) {
+            return int(record);
+        } else if (comparison < 0) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+bool ApplicationIndex::write(const QString &indexPath,
+                             const DirectoryFingerprint &applicationsFingerprint,
+                             const QVector<Entry> &entries)
+{
+    // A change made right after the fingerprint was taken might not change it
+    if (!DirectoryFingerprints::isStable(applicationsFingerprint)) {
+        qDebug() << "Not writing application index" << indexPath
+                 << "because the launch database has just been changed";
+        return false;
+    }
+
+    // Identical strings, e.g., suffixes and lists of MIME types, are stored only once
+    QByteArray strings(1, '\0');
+    QHash<QByteArray, quint32> stringOffsets;
+    stringOffsets.insert(QByteArray(), 0);
+    auto addString = [&](const QString &s) -> quint32 {
+        const QByteArray utf8 = s.toUtf8();
+        auto it = stringOffsets.constFind(utf8);
+        if (it != stringOffsets.constEnd()) {
+            return it.value();
+        }
+        quint32 offset = quint32(strings.size());
+        strings.append(utf8);
+        strings.append('\0');
+        stringOffsets.insert(utf8, offset);
+        return offset;
+    };
+
+    QVector<quint32> lists;
+    auto addList = [&](const QStringList &values) -> quint32 {
+        quint32 offset = quint32(lists.size());
+        lists.append(quint32(values.size()));
+        for (const QString &value : values) {
+            lists.append(addString(value));
+        }
+        return offset;
+    };
+
+    QVector<quint32> records;
+    records.reserve(entries.size() * FIELDS_PER_RECORD);
+    for (const Entry &entry : entries) {
+        records.append(addString(entry.path));
+        records.append(addString(entry.name));
+        records.append(addString(entry.suffix));
+        records.append(addString(entry.canOpen));
+        records.append(addList(entry.links));
+    }
+
+    // Invert the can-open lists, keeping the applications in database order
+    QMap<QByteArray, QStringList> handlersByMimeType;
+    QMap<QByteArray, QStringList> handlersByMediaType;
+    for (const Entry &entry : entries) {
+        QStringList mimeTypes = entry.canOpen.split(";");
+        mimeTypes.removeAll("");
+        for (const QString &mimeType : mimeTypes) {
+            QStringList &handlers = handlersByMimeType[mimeType.toUtf8()];
+            if (!handlers.contains(entry.path)) {
+                handlers.append(entry.path);
+            }
+            QStringList &mediaHandlers = handlersByMediaType[mimeType.split("/").first().toUtf8()];
+            if (!mediaHandlers.contains(entry.path)) {
+                mediaHandlers.append(entry.path);
+            }
+        }
+    }
+    auto addTable = [&](const QMap<QByteArray, QStringList> &handlers) {
+        QVector<quint32> table;
+        table.reserve(handlers.size() * 2);
+        for (auto it = handlers.constBegin(); it != handlers.constEnd(); ++it) {
+            table.append(addString(QString::fromUtf8(it.key())));
+            table.append(addList(it.value()));
+        }
+        return table;
+    };
+    const QVector<quint32> mimeTypes = addTable(handlersByMimeType);
+    const QVector<quint32> mediaTypes = addTable(handlersByMediaType);
+
+    // Applications by name, preferring .app over .AppDir over .AppImage over .desktop,
+    // then the highest version, then database order
+    QVector<int> byPreference(entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+        byPreference[i] = i;
+    }
+    QVector<int> ranks(entries.size());
+    QVector<QVersionNumber> versions(entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+        ranks[i] = suffixRank(entries[i].suffix);
+        versions[i] = versionOf(entries[i].name);
+    }
+    std::stable_sort(byPreference.begin(), byPreference.end(), [&](int a, int b) {
+        if (ranks[a] != ranks[b]) {
+            return ranks[a] < ranks[b];
+        }
+        return versions[a] > versions[b];
+    });
+    QMap<QByteArray, QStringList> applicationsByName;
+    for (int i : qAsConst(byPreference)) {
+        const QStringList keys = nameKeys(entries[i].name);
+        for (const QString &key : keys) {
+            applicationsByName[key.toUtf8()].append(entries[i].path);
+        }
+    }
+    const QVector<quint32> names = addTable(applicationsByName);
+
+    QVector<quint32> byPath(entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+        byPath[i] = quint32(i);
+    }
+    QVector<QByteArray> utf8Paths;
+    utf8Paths.reserve(entries.size());
+    for (const Entry &entry : entries) {
+        utf8Paths.append(entry.path.toUtf8());
+    }
+    std::sort(byPath.begin(), byPath.end(),
+              [&utf8Paths](quint32 a, quint32 b) { return utf8Paths[a] < utf8Paths[b]; });
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.applicationCount = quint32(entries.size());
+    header.applicationsMtimeNs = applicationsFingerprint.mtimeNs;
+    header.applicationsDevice = applicationsFingerprint.device;
+    header.applicationsInode = applicationsFingerprint.inode;
+    header.recordsOffset = sizeof(header);
+    header.byPathOffset = header.recordsOffset + records.size() * sizeof(quint32);
+    header.mimeTypeCount = quint32(mimeTypes.size() / 2);
+    header.mimeTypesOffset = header.byPathOffset + byPath.size() * sizeof(quint32);
+    header.mediaTypeCount = quint32(mediaTypes.size() / 2);
+    header.mediaTypesOffset = header.mimeTypesOffset + mimeTypes.size() * sizeof(quint32);
+    header.nameCount = quint32(names.size() / 2);
+    header.namesOffset = header.mediaTypesOffset + mediaTypes.size() * sizeof(quint32);
+    header.listsOffset = header.namesOffset + names.size() * sizeof(quint32);
+    header.stringsOffset = header.listsOffset + lists.size() * sizeof(quint32);
+    header.stringsSize = quint32(strings.size());
+
+    QDir().mkpath(QFileInfo(indexPath).path());
+    QSaveFile f(indexPath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write application index" << indexPath;
+        return false;
+    }
+    f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char *>(records.constData()),
+            records.size() * sizeof(quint32));
+    f.write(reinterpret_cast<const char *>(byPath.constData()), byPath.size() * sizeof(quint32));
+    f.write(reinterpret_cast<const char *>(mimeTypes.constData()),
+            mimeTypes.size() * sizeof(quint32));
+    f.write(reinterpret_cast<const char *>(mediaTypes.constData()),
+            mediaTypes.size() * sizeof(quint32));
+    f.write(reinterpret_cast<const char *>(names.constData()), names.size() * sizeof(quint32));
+    f.write(reinterpret_cast<const char *>(lists.constData()), lists.size() * sizeof(quint32));
+    f.write(strings);
+    if (!f.commit()) {
+        qDebug() << "Cannot write application index" << indexPath;
+        return false;
+    }
+    qDebug() << "Wrote application index with" << entries.size() << "applications to"
+             << indexPath;
+    return true;
+}
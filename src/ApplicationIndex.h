@@ -0,0 +1,184 @@
+#ifndef APPLICATIONINDEX_H
+#define APPLICATIONINDEX_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct DirectoryFingerprint;
+
+/**
+ * @file ApplicationIndex.h
+ * @class ApplicationIndex
+ * @brief A compact, memory-mapped index of the applications in the launch database.
+ *
+ * The symlinks in ~/.local/share/launch/Applications remain the authoritative launch
+ * database. The index holds the same information in a single file, so that listing
+ * and looking up applications does not need any system calls per application.
+ *
+ * The index is rebuilt whenever the launch database changes and replaced atomically
+ * by renaming, so readers always see either the old or the new index. It records the
+ * modification time of the Applications directory it was built from; if the directory
+ * has changed since then, e.g., because another tool has added a symlink, the index is
+ * considered stale and is not used.
+ *
+ * It also maps each application to the symlinks in the launch database that point to it,
+ * so that removing an application does not require searching all symlinks, and each MIME
+ * type to the applications that can open it, so that finding the applications for a
+ * document is a single lookup. Likewise, applications can be looked up by name.
+ *
+ * File layout (native byte order):
+ *   Header
+ *   quint32 records[count][5]   path, name, suffix and can-open of each application as
+ *                               offsets into the string table, in database order, and
+ *                               the offset of its list of symlinks
+ *   quint32 byPath[count]       record numbers sorted by path, for binary search
+ *   quint32 mimeTypes[n][2]     MIME types and the lists of applications that can open
+ *                               them, sorted by MIME type
+ *   quint32 mediaTypes[m][2]    the same for the part of the MIME types before the '/'
+ *   quint32 names[k][2]         names and the lists of applications that have them,
+ *                               sorted by name; see nameKeys()
+ *   quint32 lists[]             for each list, the number of strings followed by
+ *                               their offsets into the string table
+ *   char strings[]              NUL-terminated UTF-8 strings
+ */
+class ApplicationIndex
+{
+public:
+    /**
+     * An application as stored in the index.
+     */
+    struct Entry
+    {
+        QString path; /**< Canonical path of the application. */
+        QString name; /**< Name without suffix, e.g., "FeatherPad". */
+        QString suffix; /**< Suffix, e.g., "app". */
+        QString canOpen; /**< Semicolon-separated MIME types the application can open. */
+        QStringList links; /**< Symlinks in the launch database that point to it. */
+    };
+
+    /**
+     * Constructor. Does not open the index yet.
+     *
+     * @param indexPath The path of the index file.
+     */
+    explicit ApplicationIndex(const QString &indexPath = defaultIndexPath());
+
+    /**
+     * Destructor. Unmaps the index.
+     */
+    ~ApplicationIndex();
+
+    /**
+     * @return The default location of the index, ~/.local/share/launch/applications.index
+     */
+    static QString defaultIndexPath();
+
+    /**
+     * Map the index if it exists, is well-formed and is not stale.
+     *
+     * @param applicationsPath The symlink directory the index must have been built from.
+     * @return True if the index can be used.
+     */
+    bool open(const QString &applicationsPath);
+
+    /**
+     * Unmap the index.
+     */
+    void close();
+
+    /**
+     * @return True if the index is mapped and can be used.
+     */
+    bool isOpen() const;
+
+    /**
+     * @return The number of applications in the index.
+     */
+    int count() const;
+
+    QString path(int i) const;
+    QString name(int i) const;
+    QString suffix(int i) const;
+    QStringList canOpen(int i) const;
+    QStringList links(int i) const;
+
+    /**
+     * @return The paths of all applications in database order.
+     */
+    QStringList paths() const;
+
+    /**
+     * Look up an application by path using binary search.
+     *
+     * @return The number of the application, or -1 if it is not in the index.
+     */
+    int find(const QString &path) const;
+
+    /**
+     * @param mimeType A MIME type, e.g., "text/plain".
+     * @return The paths of the applications that can open the MIME type, in database order.
+     */
+    QStringList handlersForMimeType(const QString &mimeType) const;
+
+    /**
+     * @param mediaType The part of a MIME type before the '/', e.g., "text".
+     * @return The paths of the applications that can open any MIME type of the media type,
+     * in database order.
+     */
+    QStringList handlersForMediaType(const QString &mediaType) const;
+
+    /**
+     * @param name A name as given to 'launch', e.g., "FeatherPad".
+     * @return The paths of the applications with this name, the preferred one first:
+     * .app before .AppDir before .AppImage before .desktop, then the highest version.
+     */
+    QStringList applicationsForName(const QString &name) const;
+
+    /**
+     * @param name The name of an application without suffix, e.g., "FeatherPad-1.2.3".
+     * @return The names under which the application can be looked up: the name itself,
+     * the part before a version ("FeatherPad"), and the last component of a
+     * reverse-DNS name ("kate" for "org.kde.kate").
+     */
+    static QStringList nameKeys(const QString &name);
+
+    /**
+     * Write an index atomically.
+     *
+     * @param indexPath The path of the index file.
+     * @param applicationsFingerprint The fingerprint of the symlink directory, taken
+     * before the entries have been read from it, so that changes made while they were
+     * being read make the index stale.
+     * @param entries The applications in database order.
+     * @return True on success.
+     */
+    static bool write(const QString &indexPath,
+                      const DirectoryFingerprint &applicationsFingerprint,
+                      const QVector<Entry> &entries);
+
+private:
+    const char *string(quint32 offset) const;
+    quint32 field(int i, int f) const;
+    QStringList list(quint32 listOffset) const;
+    QStringList lookUp(quint32 tableOffset, quint32 tableCount, const QString &key) const;
+
+    QString indexPath;
+    QFile file;
+    const uchar *data;
+    qint64 size;
+    quint32 applicationCount;
+    quint32 recordsOffset;
+    quint32 byPathOffset;
+    quint32 mimeTypeCount;
+    quint32 mimeTypesOffset;
+    quint32 mediaTypeCount;
+    quint32 mediaTypesOffset;
+    quint32 nameCount;
+    quint32 namesOffset;
+    quint32 listsOffset;
+    quint32 stringsOffset;
+};
+
+#endif // APPLICATIONINDEX_H
@@ -1,14 +1,23 @@
 #include "ApplicationInfo.h"
-#include <KWindowInfo>
+#include "ProcessInfo.h"
+#include "WindowQuery.h"
+#include <KWindowSystem>
+#include <QGuiApplication>
 #include <QDebug>
 #include <QStringList>
 #include <QString>
-#include <QProcess>
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
+#include <QHash>
+#include <QPair>
 
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #if defined(__FreeBSD__)
 #  include <sys/socket.h>
 #  include <sys/sysctl.h>
@@ -69,6 +78,41 @@ QString ApplicationInfo::applicationNiceNameForPath(const QString &path)
     return applicationNiceName;
 }
 
+#if !defined(__FreeBSD__)
+// The start time of a process in clock ticks since boot, field 22 of /proc/<pid>/stat.
+// The command name in field 2 may contain spaces and parentheses, so the fields are
+// counted from the last ')'
+static bool processStartTime(unsigned int pid, quint64 &startTime)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    char buffer[1024];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+    const char *p = strrchr(buffer, ')');
+    if (!p) {
+        return false;
+    }
+    // Field 3 follows the ')'
+    for (int field = 2; field < 22 && p; field++) {
+        p = strchr(p + 1, ' ');
+    }
+    if (!p) {
+        return false;
+    }
+    startTime = strtoull(p + 1, nullptr, 10);
+    return true;
+}
+#endif
+
 // Returns the name of the bundle
 // based on the LAUNCHED_BUNDLE environment variable set by the 'launch' command
 QString ApplicationInfo::bundlePathForPId(unsigned int pid)
@@ -77,93 +121,118 @@ QString ApplicationInfo::bundlePathForPId(unsigned int pid)
 
 #if defined(__FreeBSD__)
 
-    struct procstat *prstat = procstat_open_sysctl();
-    if (prstat == NULL) {
-        return "";
-    }
-    unsigned int cnt;
-    kinfo_proc *procinfo = procstat_getprocs(prstat, KERN_PROC_PID, pid, &cnt);
-    if (procinfo == NULL || cnt != 1) {
-        procstat_close(prstat);
+    path = ProcessInfo::environmentValue(pid_t(pid), "LAUNCHED_BUNDLE");
+
+#else
+    // Process IDs are reused, so a cached result is only valid for the process
+    // with the same start time
+    static QHash<unsigned int, QPair<quint64, QString>> cache;
+    quint64 startTime = 0;
+    if (!processStartTime(pid, startTime)) {
+        cache.remove(pid);
         return "";
     }
-    char **envs = procstat_getenvv(prstat, procinfo, 0);
-    if (envs == NULL) {
-        procstat_close(prstat);
-        return "";
+    auto it = cache.constFind(pid);
+    if (it != cache.constEnd() && it->first == startTime) {
+        return it->second;
     }
+    path = ProcessInfo::environmentValue(pid_t(pid), "LAUNCHED_BUNDLE");
+    cache.insert(pid, qMakePair(startTime, path));
+#endif
 
-    for (int i = 0; envs[i] != NULL; i++) {
-        const QString &entry = QString::fromLocal8Bit(envs[i]);
-        const int splitPos = entry.indexOf('=');
+    // qDebug() << "probono: bundlePathForPId returns:" << path;
+    return path;
+}
 
-        if (splitPos != -1) {
-            const QString &name = entry.mid(0, splitPos);
-            const QString &value = entry.mid(splitPos + 1, -1);
-            // qDebug() << "name:" << name;
-            // qDebug() << "value:" << value;
-            if (name == "LAUNCHED_BUNDLE") {
-                path = value;
-                break;
-            }
-        }
-    }
+// What is known about a window; the executable is only looked up when asked for
+struct WindowEntry
+{
+    unsigned int pid = 0;
+    QString bundle;
+    QString executable;
+    bool hasExecutable = false;
+};
+
+// The connection to the X server is opened on first use and kept open
+static const WindowQuery &windowQuery()
+{
+    static const WindowQuery query;
+    return query;
+}
 
-    procstat_freeenvv(prstat);
-    procstat_close(prstat);
+// Whether windowCache() is told about windows that are removed or added
+static bool windowChangesTracked = false;
 
-#else
-    // Linux; see Menu for a cross-platform solution?
-    qDebug() << "TODO: Implement getting env";
-    path = "ThisIsOnlyImplementedForFreeBSDSoFar";
-#endif
+// Window IDs are reused by the X server, so entries are removed when windows are
+// removed or added. KWindowSystem only reports this if there is a QGuiApplication;
+// without one, e.g., in 'launch', windowEntry() checks the process of a window instead
+static QHash<unsigned long long, WindowEntry> &windowCache()
+{
+    static QHash<unsigned long long, WindowEntry> cache;
+    static bool populated = false;
+    if (!windowChangesTracked && qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+        windowChangesTracked = true;
+        QObject::connect(KWindowSystem::self(), &KWindowSystem::windowRemoved,
+                         [](WId id) { cache.remove(id); });
+        QObject::connect(KWindowSystem::self(), &KWindowSystem::windowAdded,
+                         [](WId id) { cache.remove(id); });
+    }
+    if (!populated) {
+        // All top-level windows in one pass, with their process IDs fetched at once
+        populated = true;
+        const QVector<WindowQuery::ClientWindow> windows = windowQuery().clientWindows();
+        for (const WindowQuery::ClientWindow &window : windows) {
+            WindowEntry entry;
+            entry.pid = window.pid;
+            entry.bundle = ApplicationInfo::bundlePathForPId(window.pid);
+            cache.insert(window.id, entry);
+        }
+    }
+    return cache;
+}
 
-    // qDebug() << "probono: bundlePathForPId returns:" << path;
-    return path;
+static WindowEntry &windowEntry(unsigned long long id)
+{
+    QHash<unsigned long long, WindowEntry> &cache = windowCache();
+    auto it = cache.find(id);
+    if (it != cache.end() && !windowChangesTracked) {
+        // The window may have been replaced by one of another process with the same ID
+        const pid_t pid = windowQuery().pid(id);
+        if (pid != pid_t(it->pid)) {
+            cache.erase(it);
+            it = cache.end();
+        }
+    }
+    if (it == cache.end()) {
+        // E.g., a transient window, which is not in _NET_CLIENT_LIST
+        WindowEntry entry;
+        entry.pid = windowQuery().pid(id);
+        entry.bundle = ApplicationInfo::bundlePathForPId(entry.pid);
+        it = cache.insert(id, entry);
+    }
+    return *it;
 }
 
 QString ApplicationInfo::bundlePathForWId(unsigned long long id)
 {
-    QString path;
-    KWindowInfo info(id, NET::WMPid, NET::WM2TransientFor | NET::WM2WindowClass);
-    return bundlePathForPId(info.pid());
+    return windowEntry(id).bundle;
 }
 
 QString ApplicationInfo::pathForWId(unsigned long long id)
 {
-    QString path;
-    KWindowInfo info(id, NET::WMPid, NET::WM2TransientFor | NET::WM2WindowClass);
-
-    // qDebug() << "probono: info.pid():" << info.pid();
-    // qDebug() << "probono: info.windowClassName():" << info.windowClassName();
-
-    QProcess p;
-    QStringList arguments;
-    if (QFile::exists(QString("/proc/%1/file").arg(info.pid()))) {
-        // FreeBSD
-        arguments = QStringList() << "-f" << QString("/proc/%1/file").arg(info.pid());
-    } else if (QFile::exists(QString("/proc/%1/exe").arg(info.pid()))) {
-        // Linux
-        arguments = QStringList() << "-f" << QString("/proc/%1/exe").arg(info.pid());
-    }
-    p.start("readlink", arguments);
-    p.waitForFinished();
-    QString retStr(p.readAllStandardOutput().trimmed());
-    if (!retStr.isEmpty()) {
-        // qDebug() << "probono:" << p.program() << p.arguments();
-        // qDebug() << "probono: retStr:" << retStr;
-        path = retStr;
-    }
-    // qDebug() << "probono: pathForWId returns:" << path;
-    return path;
+    WindowEntry &entry = windowEntry(id);
+    if (!entry.hasExecutable) {
+        entry.hasExecutable = true;
+        entry.executable = ProcessInfo::executable(pid_t(entry.pid));
+    }
+    // qDebug() << "probono: pathForWId returns:" << entry.executable;
+    return entry.executable;
 }
 
 QString ApplicationInfo::applicationNiceNameForWId(unsigned long long id)
 {
-    QString path;
     QString applicationNiceName;
-    KWindowInfo info(id, NET::WMPid, NET::WM2TransientFor | NET::WM2WindowClass);
-    applicationNiceName = applicationNiceNameForPath(bundlePathForPId(info.pid()));
+    applicationNiceName = applicationNiceNameForPath(bundlePathForWId(id));
     if (applicationNiceName.isEmpty()) {
         applicationNiceName = QFileInfo(pathForWId(id)).fileName();
     }
@@ -63,6 +63,8 @@ public:
      * Get the bundle path for a given window ID.
      *
      * This function returns the bundle path associated with a window ID.
+     * The process IDs and bundles of all top-level windows are looked up in one pass
+     * the first time and cached until the windows are removed.
      *
      * @param id The window ID.
      * @return The bundle path.
@@ -0,0 +1,143 @@
+#include "ApplicationWatcher.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+
+#include "AppScanner.h"
+#include "DirectoryFingerprints.h"
+
+ApplicationWatcher::ApplicationWatcher(DbManager *db, QObject *parent)
+    : QObject(parent), db(db), watcher(new QFileSystemWatcher(this))
+{
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this,
+            &ApplicationWatcher::directoryChanged);
+}
+
+ApplicationWatcher::~ApplicationWatcher() { }
+
+bool ApplicationWatcher::watch(const QStringList &locationsContainingApps)
+{
+    roots = locationsContainingApps;
+    bool complete = true;
+    for (const QString &location : locationsContainingApps) {
+        if (QFileInfo(location).isDir() && !addDirectory(location, false)) {
+            complete = false;
+        }
+    }
+    qDebug() << "Watching" << watcher->directories().size() << "directories for applications";
+    return complete;
+}
+
+// Start watching a directory and the subdirectories in it that may contain applications.
+// Like AppScanner, directories are identified by device and inode, so that a directory
+// that can be reached through symlinks, e.g., one pointing back to an ancestor, is only
+// watched once
+bool ApplicationWatcher::addDirectory(const QString &directory, bool handleApplications)
+{
+    if (applications.contains(directory)) {
+        return true;
+    }
+    DirectoryFingerprint fingerprint;
+    if (!DirectoryFingerprints::currentFingerprint(directory, fingerprint)) {
+        return true;
+    }
+    const QPair<quint64, quint64> identity = qMakePair(fingerprint.device, fingerprint.inode);
+    if (watchedIdentities.contains(identity)) {
+        return true;
+    }
+    watchedIdentities.insert(identity);
+    identities.insert(directory, identity);
+
+    QStringList apps;
+    QStringList subdirs;
+    AppScanner::listDirectory(directory, roots, apps, subdirs);
+    applications.insert(directory, apps.toSet());
+    subdirectories.insert(directory, subdirs.toSet());
+
+    bool complete = watcher->addPath(directory);
+    if (!complete) {
+        qDebug() << "Cannot watch" << directory;
+    }
+
+    if (handleApplications) {
+        for (const QString &app : qAsConst(apps)) {
+            qDebug() << "Application appeared:" << app;
+            db->handleApplication(app);
+        }
+    }
+
+    for (const QString &subdir : qAsConst(subdirs)) {
+        if (!addDirectory(subdir, handleApplications)) {
+            complete = false;
+        }
+    }
+    return complete;
+}
+
+// Stop watching a directory that has disappeared, and remove the applications
+// that were in it from the launch database
+void ApplicationWatcher::removeDirectory(const QString &directory)
+{
+    if (!applications.contains(directory)) {
+        return;
+    }
+
+    watchedIdentities.remove(identities.take(directory));
+    const QSet<QString> subdirs = subdirectories.take(directory);
+    for (const QString &subdir : subdirs) {
+        removeDirectory(subdir);
+    }
+
+    const QStringList apps = applications.take(directory).values();
+    qDebug() << "Applications disappeared:" << apps;
+    db->handleApplications(apps);
+
+    watcher->removePath(directory);
+}
+
+void ApplicationWatcher::directoryChanged(const QString &directory)
+{
+    if (!QFileInfo(directory).isDir()) {
+        removeDirectory(directory);
+        db->writeIndex();
+        return;
+    }
+
+    QStringList apps;
+    QStringList subdirs;
+    AppScanner::listDirectory(directory, roots, apps, subdirs);
+    const QSet<QString> currentApps = apps.toSet();
+    const QSet<QString> currentSubdirs = subdirs.toSet();
+    const QSet<QString> previousApps = applications.value(directory);
+    const QSet<QString> previousSubdirs = subdirectories.value(directory);
+
+    // A move within or between watched directories shows up as a removal in one
+    // directory and a creation in another
+    const QStringList disappearedApps = (previousApps - currentApps).values();
+    if (!disappearedApps.isEmpty()) {
+        qDebug() << "Applications disappeared:" << disappearedApps;
+        db->handleApplications(disappearedApps);
+    }
+    for (const QString &app : currentApps) {
+        if (!previousApps.contains(app)) {
+            qDebug() << "Application appeared:" << app;
+            db->handleApplication(app);
+        }
+    }
+    applications.insert(directory, currentApps);
+
+    for (const QString &subdir : previousSubdirs) {
+        if (!currentSubdirs.contains(subdir)) {
+            removeDirectory(subdir);
+        }
+    }
+    subdirectories.insert(directory, currentSubdirs);
+    for (const QString &subdir : currentSubdirs) {
+        if (!previousSubdirs.contains(subdir)) {
+            addDirectory(subdir, true);
+        }
+    }
+
+    db->writeIndex();
+}
@@ -0,0 +1,70 @@
+#ifndef APPLICATIONWATCHER_H
+#define APPLICATIONWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+
+#include "DbManager.h"
+
+class QFileSystemWatcher;
+
+/**
+ * @file ApplicationWatcher.h
+ * @class ApplicationWatcher
+ * @brief Keeps the launch database up to date by watching application locations.
+ *
+ * The directories in which applications are searched for are watched for changes
+ * (using inotify on Linux and kqueue on FreeBSD). When applications are created, deleted,
+ * or moved, only the affected entries are added to or removed from the launch database,
+ * so that it stays current without rediscovering applications.
+ */
+class ApplicationWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param db The launch database to be kept up to date.
+     * @param parent The parent object.
+     */
+    explicit ApplicationWatcher(DbManager *db, QObject *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    ~ApplicationWatcher();
+
+    /**
+     * Watch locations and the subdirectories in them that may contain applications.
+     *
+     * The applications that exist when watching starts are assumed to be in the
+     * launch database already.
+     *
+     * @param locationsContainingApps The locations to be watched.
+     * @return False if not all directories could be watched, e.g., because the
+     * limit of inotify watches has been reached.
+     */
+    bool watch(const QStringList &locationsContainingApps);
+
+private slots:
+    void directoryChanged(const QString &directory);
+
+private:
+    bool addDirectory(const QString &directory, bool handleApplications);
+    void removeDirectory(const QString &directory);
+
+    DbManager *db;
+    QFileSystemWatcher *watcher;
+    QStringList roots;
+    QHash<QString, QSet<QString>> applications; /**< Applications in each watched directory. */
+    QHash<QString, QSet<QString>> subdirectories; /**< Watched subdirectories of each directory. */
+    QHash<QString, QPair<quint64, quint64>> identities; /**< Device and inode of each one. */
+    QSet<QPair<quint64, quint64>> watchedIdentities; /**< Device and inode of all of them. */
+};
+
+#endif // APPLICATIONWATCHER_H
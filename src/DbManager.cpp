@@ -1,10 +1,25 @@
 #include "DbManager.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QMessageBox>
+#include "DirectoryFingerprints.h"
 #include "extattrs.h"
+#include "ExtattrSupport.h"
+#include "GuiApplication.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
 
 
 // Make localShareLaunchApplicationsPath available to other classes
@@ -16,61 +31,528 @@ const QString DbManager::localShareLaunchApplicationsPath =
 const QString DbManager::localShareLaunchMimePath =
         QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/launch/MIME/";
 
-DbManager::DbManager() : filesystemSupportsExtattr(false)
+// How often symlinks to applications that no longer exist are removed
+static const qint64 GARBAGE_COLLECTION_INTERVAL_SECS = 60 * 60;
+
+static const quint32 JOURNAL_MAGIC = 0x4c4a524e; // "LJRN"
+static const quint32 JOURNAL_VERSION = 1;
+
+// If collectGarbage is false, the caller knows that the launch database
+// is being kept up to date already, e.g., by the launch daemon
+DbManager::DbManager(bool collectGarbage)
+    : collectGarbage(collectGarbage),
+      inTransaction(false),
+      indexChecked(false),
+      linksKnown(false)
 {
 
     qDebug() << "DbManager::DbManager()";
 
-    // In order to find out whether it is worth doing costly operations regarding
-    // extattrs we check whether the filesystem supports them and only use them if
-    // it does. This should help speed up things on Live ISOs where extattrs don't
-    // seem to be supported.
-    bool ok = false;
-    ok = Fm::setAttributeValueInt("/usr", "filesystemSupportsExtattr", true);
-    if (ok) {
-        filesystemSupportsExtattr = true;
-        qDebug() << "Extended attributes are supported on /usr; using them";
-    } else {
-        qDebug() << "Extended attributes are not supported on /usr\n"
-                    "or the command to set them needs 'chmod +s'; system will be slower";
-    }
-
     // Create localShareLaunchMimePath and localShareLaunchApplicationsPath
     QDir dir;
     dir.mkpath(localShareLaunchMimePath);
     dir.mkpath(localShareLaunchApplicationsPath);
 
-    // Check all symlinks in ~/.local/share/launch/ and remove any
-    // that point to non-existent files.
-    // TODO: Move to a location where it is
-    // only run periodically, e.g., when the application starts, or run delayed
-    // after an application is added
+    // Finish the transactions of processes that were interrupted while committing
+    _replayJournals();
+}
+
+QString DbManager::_databasePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/launch";
+}
+
+// Each process writes its own journal, so that concurrent commits do not
+// overwrite each other's
+QString DbManager::_journalPath(qint64 pid)
+{
+    return _databasePath() + "/journal." + QString::number(pid);
+}
+
+// Serialises commits and journal replays of all processes by holding an flock on
+// ~/.local/share/launch while it exists; the lock is released when the descriptor
+// is closed
+class DatabaseLock
+{
+public:
+    explicit DatabaseLock(const QString &path)
+        : fd(open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+    {
+        if (fd == -1) {
+            qDebug() << "Cannot open" << path << "for locking";
+            return;
+        }
+        while (flock(fd, LOCK_EX) == -1 && errno == EINTR) { }
+    }
+    ~DatabaseLock()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+private:
+    int fd;
+};
+
+// Start collecting changes to the launch database in memory instead of applying them
+// one by one. The symlinks in ~/.local/share/launch/Applications are read once here;
+// the MIME directories are read when they are first needed. Until commit() is called,
+// only this DbManager sees the changes
+void DbManager::begin()
+{
+    if (inTransaction) {
+        return;
+    }
+    inTransaction = true;
+    transaction = Transaction();
     QDirIterator it(localShareLaunchApplicationsPath,
-                    QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+                    QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
     while (it.hasNext()) {
         QString symlinkPath = it.next();
-        if (QFileInfo(symlinkPath).isSymLink()
-            && !QFileInfo(QFileInfo(symlinkPath).symLinkTarget()).exists()) {
-            handleNonExistingApplicationSymlink(symlinkPath);
+        transaction.applicationNames.insert(it.fileName());
+        QFileInfo info(symlinkPath);
+        if (info.isSymLink()) {
+            transaction.linkByTarget.insert(info.symLinkTarget(), symlinkPath);
         }
     }
+}
 
-    // Check all symlinks in ~/.local/share/launch/MIME/ and remove any
-    // that point to non-existent files.
-    // after an application is added
-    QDirIterator it2(localShareLaunchMimePath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-    while (it2.hasNext()) {
-        QString symlinkPath = it2.next();
-        if (QFileInfo(symlinkPath).isSymLink()
-            && !QFileInfo(QFileInfo(symlinkPath).symLinkTarget()).exists()) {
-            handleNonExistingApplicationSymlink(symlinkPath);
+// Apply the changes collected since begin(). They are written to a journal first,
+// so that if the process is interrupted, the next DbManager applies the rest
+bool DbManager::commit()
+{
+    if (!inTransaction) {
+        return false;
+    }
+    inTransaction = false;
+    const QVector<Operation> operations = transaction.operations;
+    transaction = Transaction();
+    if (operations.isEmpty()) {
+        return true;
+    }
+
+    qDebug() << "Committing" << operations.size() << "changes to the launch database";
+    DatabaseLock lock(_databasePath());
+    const QString journalPath = _journalPath(QCoreApplication::applicationPid());
+    const bool journaled = _writeJournal(journalPath, operations);
+    const bool success = _applyOperations(operations);
+    if (journaled) {
+        QFile::remove(journalPath);
+    }
+    return success;
+}
+
+bool DbManager::_writeJournal(const QString &journalPath,
+                              const QVector<Operation> &operations) const
+{
+    QSaveFile f(journalPath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write journal to" << journalPath;
+        return false;
+    }
+    QDataStream out(&f);
+    out << JOURNAL_MAGIC << JOURNAL_VERSION << quint32(operations.size());
+    for (const Operation &operation : operations) {
+        out << quint8(operation.kind) << operation.target << operation.path;
+    }
+    if (!f.commit()) {
+        qDebug() << "Cannot write journal to" << journalPath;
+        return false;
+    }
+    return true;
+}
+
+// A journal is only ever renamed into place complete, so it either exists in full
+// or not at all. Only the journals of processes that do not exist anymore are
+// replayed; operations that have already been applied, or that the launch database
+// has moved past since, are skipped
+void DbManager::_replayJournals()
+{
+    const QStringList journals =
+            QDir(_databasePath()).entryList({ "journal.*" }, QDir::Files | QDir::Hidden);
+    if (journals.isEmpty()) {
+        return;
+    }
+
+    DatabaseLock lock(_databasePath());
+    for (const QString &journal : journals) {
+        bool ok = false;
+        const qint64 pid = journal.mid(int(strlen("journal."))).toLongLong(&ok);
+        if (!ok || pid == QCoreApplication::applicationPid()
+            || kill(pid_t(pid), 0) == 0 || errno == EPERM) {
+            continue;
+        }
+        const QString journalPath = _databasePath() + "/" + journal;
+        QFile f(journalPath);
+        if (!f.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QDataStream in(&f);
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint32 count = 0;
+        in >> magic >> version >> count;
+        QVector<Operation> operations;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            quint8 kind = 0;
+            Operation operation;
+            in >> kind >> operation.target >> operation.path;
+            operation.kind = Operation::Kind(kind);
+            operations.append(operation);
+        }
+        f.close();
+        if (magic != JOURNAL_MAGIC || version != JOURNAL_VERSION
+            || in.status() != QDataStream::Ok) {
+            qDebug() << "Ignoring journal in unknown format at" << journalPath;
+        } else {
+            qDebug() << "Replaying" << operations.size() << "changes from" << journalPath;
+            _applyOperations(operations);
         }
+        QFile::remove(journalPath);
     }
 }
 
+bool DbManager::_applyOperations(const QVector<Operation> &operations)
+{
+    // Keep the symlinks that point to each application from the index before it becomes
+    // stale, and update them as symlinks are created and removed, so that rewriting the
+    // index does not need to search all symlinks again
+    if (!linksKnown && _indexIsFresh()) {
+        linksByApplication.clear();
+        for (int i = 0; i < index.count(); i++) {
+            linksByApplication.insert(index.path(i), index.links(i));
+        }
+        linksKnown = true;
+    }
+
+    bool success = true;
+    for (const Operation &operation : operations) {
+        QFileInfo info(operation.path);
+        if (operation.kind == Operation::Link) {
+            // The application may have been deleted since the operation was recorded
+            if ((info.isSymLink() && info.symLinkTarget() == operation.target)
+                || !QFileInfo::exists(operation.target)) {
+                continue;
+            }
+            if (!QFile::link(operation.target, operation.path)
+                && !(QDir().mkpath(info.path())
+                     && QFile::link(operation.target, operation.path))) {
+                qDebug() << "Failed to create symlink:" << operation.path;
+                success = false;
+                continue;
+            }
+            qDebug() << "Created symlink:" << operation.path;
+            if (linksKnown) {
+                linksByApplication[operation.target].append(operation.path);
+            }
+        } else {
+            // Only symlinks to applications that do not exist are removed; if the
+            // symlink points to an existing application, it has been added again since
+            if (!info.isSymLink() || info.exists()) {
+                continue;
+            }
+            if (!QFile::remove(operation.path)) {
+                qDebug() << "Failed to remove symlink:" << operation.path;
+                success = false;
+                continue;
+            }
+            qDebug() << "Removed symlink:" << operation.path;
+            if (linksKnown) {
+                for (QStringList &links : linksByApplication) {
+                    links.removeAll(operation.path);
+                }
+            }
+        }
+        if (operation.path.startsWith(localShareLaunchApplicationsPath)) {
+            _invalidateIndex();
+        }
+    }
+    return success;
+}
+
+// Create a symlink, or record it in the transaction
+bool DbManager::_link(const QString &target, const QString &linkPath)
+{
+    if (inTransaction) {
+        transaction.operations.append({ Operation::Link, target, linkPath });
+        return true;
+    }
+    return _applyOperations({ { Operation::Link, target, linkPath } });
+}
+
+// Remove a symlink, or record its removal in the transaction
+bool DbManager::_unlink(const QString &symlinkPath)
+{
+    if (inTransaction) {
+        transaction.operations.append({ Operation::Unlink, QString(), symlinkPath });
+        const QFileInfo info(symlinkPath);
+        if (symlinkPath.startsWith(localShareLaunchApplicationsPath)) {
+            transaction.applicationNames.remove(info.fileName());
+            transaction.linkByTarget.remove(transaction.linkByTarget.key(symlinkPath));
+        } else {
+            _mimeLinks(info.path()).remove(info.fileName());
+        }
+        return true;
+    }
+    return _applyOperations({ { Operation::Unlink, QString(), symlinkPath } });
+}
+
+// The file names in a MIME directory as they will be after commit()
+QSet<QString> &DbManager::_mimeLinks(const QString &mimeDir)
+{
+    auto it = transaction.mimeLinks.find(mimeDir);
+    if (it == transaction.mimeLinks.end()) {
+        QSet<QString> names;
+        QDirIterator links(mimeDir, QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
+        while (links.hasNext()) {
+            links.next();
+            names.insert(links.fileName());
+        }
+        it = transaction.mimeLinks.insert(mimeDir, names);
+    }
+    return *it;
+}
+
+// In order to find out whether it is worth doing costly operations regarding
+// extattrs we check whether the filesystem supports them and only use them if
+// it does. This should help speed up things on Live ISOs where extattrs don't
+// seem to be supported.
+bool DbManager::filesystemSupportsExtattr(const QString &path) const
+{
+    return ExtattrSupport::isSupported(path);
+}
+
+// Remove the symlinks in ~/.local/share/launch/Applications and in the
+// subdirectories of ~/.local/share/launch/MIME that point to non-existent files,
+// and the MIME directories that are empty afterwards.
+// Broken symlinks are only listed by QDirIterator if QDir::System is given
+DbManager::GarbageCollectionStats DbManager::removeDanglingSymlinks() const
+{
+    GarbageCollectionStats stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto isDangling = [](const QString &path) {
+        QFileInfo info(path);
+        return info.isSymLink() && !info.exists();
+    };
+
+    QDirIterator it(localShareLaunchApplicationsPath,
+                    QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        QString symlinkPath = it.next();
+        stats.checkedLinks++;
+        if (isDangling(symlinkPath) && handleNonExistingApplicationSymlink(symlinkPath)) {
+            stats.removedApplicationLinks++;
+        }
+    }
+
+    // ~/.local/share/launch/MIME/<type_subtype>/<symlink>
+    QDirIterator mimeTypes(localShareLaunchMimePath, QDir::Dirs | QDir::NoDotAndDotDot);
+    while (mimeTypes.hasNext()) {
+        QString mimeTypePath = mimeTypes.next();
+        if (QFileInfo(mimeTypePath).isSymLink()) {
+            continue;
+        }
+        QDirIterator links(mimeTypePath,
+                           QDir::Files | QDir::Dirs | QDir::System | QDir::NoDotAndDotDot);
+        bool empty = true;
+        while (links.hasNext()) {
+            QString symlinkPath = links.next();
+            stats.checkedLinks++;
+            if (isDangling(symlinkPath) && handleNonExistingApplicationSymlink(symlinkPath)) {
+                stats.removedMimeLinks++;
+            } else {
+                empty = false;
+            }
+        }
+        // rmdir only succeeds if the directory is really empty
+        if (empty && QDir().rmdir(mimeTypePath)) {
+            stats.removedMimeDirectories++;
+        }
+    }
+
+    stats.msecs = timer.elapsed();
+    qDebug() << "Checked" << stats.checkedLinks << "symlinks in" << stats.msecs
+             << "milliseconds; removed" << stats.removedApplicationLinks
+             << "from Applications," << stats.removedMimeLinks << "from MIME, and"
+             << stats.removedMimeDirectories << "empty MIME directories";
+    return stats;
+}
+
 DbManager::~DbManager()
 {
     qDebug() << "DbManager::~DbManager()";
+    commit();
+    collectGarbageIfDue();
+    writeIndex();
+}
+
+QString DbManager::garbageCollectionStampPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/last-garbage-collection";
+}
+
+// Remove dangling symlinks unless this has been done within the last
+// GARBAGE_COLLECTION_INTERVAL_SECS, as recorded in the stamp file. The stamp is
+// written first, so that processes running at the same time do not all do it.
+// Callers do this once the application has been launched or the document has been
+// opened, so that the user does not have to wait for it.
+// Returns true if the symlinks have been checked
+bool DbManager::collectGarbageIfDue() const
+{
+    if (!collectGarbage) {
+        return false;
+    }
+    const QString stampPath = garbageCollectionStampPath();
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QFile stamp(stampPath);
+    if (stamp.open(QIODevice::ReadOnly)) {
+        bool ok = false;
+        const qint64 last = stamp.readAll().trimmed().toLongLong(&ok);
+        stamp.close();
+        if (ok && last <= now && now - last < GARBAGE_COLLECTION_INTERVAL_SECS) {
+            return false;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(stampPath).path());
+    if (!stamp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Cannot write" << stampPath;
+        return false;
+    }
+    stamp.write(QByteArray::number(now));
+    stamp.close();
+
+    removeDanglingSymlinks();
+    return true;
+}
+
+// Returns true if ~/.local/share/launch/applications.index matches the symlinks in
+// ~/.local/share/launch/Applications and can be used instead of them
+bool DbManager::_indexIsFresh() const
+{
+    if (!indexChecked) {
+        indexChecked = true;
+        index.open(localShareLaunchApplicationsPath);
+    }
+    return index.isOpen();
+}
+
+// Called whenever the symlinks have been changed; the index is not used
+// anymore until it has been rewritten
+void DbManager::_invalidateIndex() const
+{
+    index.close();
+    indexChecked = true;
+}
+
+// Rewrite ~/.local/share/launch/applications.index from the symlinks in
+// ~/.local/share/launch/Applications if they have changed since it was written.
+// If rebuild is true, it is rewritten regardless, e.g., to pick up changes to the
+// MIME types that the applications can open, and all symlinks in
+// ~/.local/share/launch/MIME are searched again
+bool DbManager::writeIndex(bool rebuild)
+{
+    if (!rebuild && _indexIsFresh()) {
+        return true;
+    }
+
+    // Taken before scanning, so that symlinks changed during the scan make the index stale
+    DirectoryFingerprint fingerprint;
+    if (!DirectoryFingerprints::currentFingerprint(localShareLaunchApplicationsPath,
+                                                   fingerprint)) {
+        return false;
+    }
+
+    QVector<ApplicationIndex::Entry> entries;
+    const QStringList applications = _scanApplications();
+    if (rebuild || !linksKnown) {
+        linksByApplication = _scanLinks(applications.toSet());
+        linksKnown = true;
+    }
+    const QHash<QString, QStringList> &links = linksByApplication;
+    // Read the can-open attributes of the applications on filesystems that support
+    // them at once, so that the reads overlap
+    QStringList applicationsWithExtattrs;
+    for (const QString &application : applications) {
+        if (filesystemSupportsExtattr(application)) {
+            applicationsWithExtattrs.append(application);
+        }
+    }
+    const QVector<QHash<QString, QString>> allAttributes =
+            Fm::getAttributeValues(applicationsWithExtattrs, { "can-open" });
+    int withExtattrs = 0;
+    for (const QString &application : applications) {
+        ApplicationIndex::Entry entry;
+        entry.path = application;
+        entry.links = links.value(application);
+        entry.name = QFileInfo(application).completeBaseName();
+        entry.suffix = QFileInfo(application).suffix();
+        bool ok = false;
+        QString canOpen;
+        if (withExtattrs < applicationsWithExtattrs.size()
+            && applicationsWithExtattrs.at(withExtattrs) == application) {
+            const QHash<QString, QString> &attributes = allAttributes.at(withExtattrs++);
+            ok = attributes.contains("can-open");
+            canOpen = attributes.value("can-open");
+        }
+        if (!ok) {
+            canOpen = getCanOpenFromFile(application);
+        }
+        QStringList mimeTypes = canOpen.split(";");
+        for (int i = 0; i < mimeTypes.size(); ++i) {
+            mimeTypes[i] = mimeTypes[i].trimmed();
+        }
+        mimeTypes.removeAll("");
+        entry.canOpen = mimeTypes.join(";");
+        entries.append(entry);
+    }
+
+    if (!ApplicationIndex::write(ApplicationIndex::defaultIndexPath(), fingerprint, entries)) {
+        return false;
+    }
+    return index.open(localShareLaunchApplicationsPath);
+}
+
+// Find the symlinks in ~/.local/share/launch/Applications and the subdirectories of
+// ~/.local/share/launch/MIME that point to each of the applications
+QHash<QString, QStringList> DbManager::_scanLinks(const QSet<QString> &applications) const
+{
+    QHash<QString, QStringList> results;
+
+    auto addLink = [&](const QString &symlinkPath) {
+        if (!QFileInfo(symlinkPath).isSymLink()) {
+            return;
+        }
+        // Only resolve the target if it does not point to an application directly,
+        // e.g., for symlinks to symlinks in ~/.local/share/launch/Applications
+        QString target = QFileInfo(symlinkPath).symLinkTarget();
+        if (!applications.contains(target)) {
+            target = QFileInfo(target).canonicalFilePath();
+        }
+        if (applications.contains(target)) {
+            results[target].append(symlinkPath);
+        }
+    };
+
+    QDirIterator it(localShareLaunchApplicationsPath,
+                    QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        addLink(it.next());
+    }
+
+    QDirIterator it2(localShareLaunchMimePath, QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it2.hasNext()) {
+        QDirIterator it3(it2.next(), QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it3.hasNext()) {
+            addLink(it3.next());
+        }
+    }
+
+    return results;
 }
 
 // Read "can-open" file and return its contents as a QString;
@@ -125,7 +607,29 @@ QString DbManager::getCanOpenFromFile(QString canonicalPath)
 
 void DbManager::handleApplication(QString path)
 {
-    QString canonicalPath = QDir(path).canonicalPath();
+    handleApplications({ path });
+}
+
+// Applications that do not exist anymore are collected and removed from the launch
+// database together, so that the symlinks have to be searched at most once
+void DbManager::handleApplications(const QStringList &paths)
+{
+    QStringList removals;
+    for (const QString &path : paths) {
+        QString canonicalPath = QDir(path).canonicalPath();
+        if (canonicalPath.isEmpty() || !_handleExistingApplication(canonicalPath)) {
+            qDebug() << path << "does not exist, removing from launch.db";
+            removals.append(path);
+        }
+    }
+    if (!removals.isEmpty()) {
+        _removeApplications(removals);
+    }
+}
+
+// Returns false if the application does not exist
+bool DbManager::_handleExistingApplication(const QString &canonicalPath)
+{
 
     // If it is a symlink, check whether it points to an existing file
     bool symlinkTargetExists = true;
@@ -136,8 +640,7 @@ void DbManager::handleApplication(QString path)
     }
 
     if (! symlinkTargetExists || !(QFileInfo(canonicalPath).isDir() || QFileInfo(canonicalPath).isFile())) {
-        qDebug() << canonicalPath << "does not exist, removing from launch.db";
-        _removeApplication(canonicalPath);
+        return false;
     } else {
         // qDebug() << "Adding" << canonicalPath << "to launch.db";
         _addApplication(canonicalPath);
@@ -145,10 +648,10 @@ void DbManager::handleApplication(QString path)
         QString mime = getCanOpenFromFile(canonicalPath);
         if (mime.isEmpty()) {
             qDebug() << "No MIME types found in" << canonicalPath;
-            return;
+            return true;
         } else if (mime == "") {
             qDebug() << "Empty MIME types found in" << canonicalPath;
-            return;
+            return true;
         }
 
         // Split mime types into a QStringList
@@ -168,19 +671,26 @@ void DbManager::handleApplication(QString path)
             }
 
             QString mimeDir = localShareLaunchMimePath + "/" + mime.replace("/", "_");
-            if (!QFileInfo(mimeDir).isDir()) {
-                QDir dir;
-                dir.mkpath(mimeDir);
-            }
-
             QString link = mimeDir + "/" + QFileInfo(canonicalPath).fileName();
 
-            if (QFileInfo(link).isSymLink()) {
-                // qDebug() << "Not creating symlink for" << mime << "because it already"
-                //          << "exists";
-                continue;
+            if (inTransaction) {
+                QSet<QString> &names = _mimeLinks(mimeDir);
+                if (names.contains(QFileInfo(link).fileName())) {
+                    continue;
+                }
+                names.insert(QFileInfo(link).fileName());
+            } else {
+                if (!QFileInfo(mimeDir).isDir()) {
+                    QDir dir;
+                    dir.mkpath(mimeDir);
+                }
+                if (QFileInfo(link).isSymLink()) {
+                    // qDebug() << "Not creating symlink for" << mime << "because it already"
+                    //          << "exists";
+                    continue;
+                }
             }
-            bool ok = QFile::link(canonicalPath, link);
+            bool ok = _link(canonicalPath, link);
             if (ok) {
                 qDebug() << "Created symlink for" << mime << "in" << localShareLaunchMimePath;
             } else {
@@ -190,8 +700,8 @@ void DbManager::handleApplication(QString path)
 
         // If extended attributes are not supported, there is nothing else to be
         // done here
-        if (!filesystemSupportsExtattr) {
-            return;
+        if (!filesystemSupportsExtattr(canonicalPath)) {
+            return true;
         }
 
         // Set 'can-open' extattr if 'can-open' extattr doesn't already exist but
@@ -199,7 +709,7 @@ void DbManager::handleApplication(QString path)
         bool ok = false;
         Fm::getAttributeValueQString(canonicalPath, "can-open", ok);
         if (ok)
-            return; // extattr is already set
+            return true; // extattr is already set
 
         // Set 'can-open' extattr on the application
         ok = Fm::setAttributeValueQString(canonicalPath, "can-open", mime);
@@ -209,6 +719,7 @@ void DbManager::handleApplication(QString path)
             qDebug() << "Cannot set xattr 'can-open' on" << canonicalPath;
         }
     }
+    return true;
 }
 
 bool DbManager::_addApplication(const QString &path)
@@ -243,102 +754,142 @@ bool DbManager::_addApplication(const QString &path)
 
     bool found = false;
 
-    // Check for symlinks that start with the name of the target sans extension
-    // to also catch -2, -3, etc.
-    QDirIterator it2(localShareLaunchApplicationsPath,
-                     QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-    while (it2.hasNext()) {
-        QString symlinkPath = it2.next();
-        if (QFileInfo(symlinkPath).symLinkTarget() == path) {
-            found = true;
-            break;
+    if (inTransaction) {
+        found = transaction.linkByTarget.contains(path);
+    } else {
+        // Check for symlinks that start with the name of the target sans extension
+        // to also catch -2, -3, etc.
+        QDirIterator it2(localShareLaunchApplicationsPath,
+                         QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it2.hasNext()) {
+            QString symlinkPath = it2.next();
+            if (QFileInfo(symlinkPath).symLinkTarget() == path) {
+                found = true;
+                break;
+            }
         }
     }
 
     if (!found) {
+        auto nameIsTaken = [this](const QString &linkPath) {
+            if (inTransaction) {
+                return transaction.applicationNames.contains(QFileInfo(linkPath).fileName());
+            }
+            return QFileInfo(linkPath).exists();
+        };
         QString linkPath = localShareLaunchApplicationsPath + QFileInfo(path).fileName();
         int i = 2;
-        while (QFileInfo(linkPath).exists()) {
+        while (nameIsTaken(linkPath)) {
             linkPath = localShareLaunchApplicationsPath + targetName + "-" + QString::number(i)
                     + "." + targetCompleteSuffix;
             i++;
         }
-        if (QFile::link(path, linkPath)) {
-            qDebug() << "Created symlink:" << linkPath;
-            success = true;
-        } else {
-            qDebug() << "Failed to create symlink:" << linkPath;
+        if (inTransaction) {
+            transaction.applicationNames.insert(QFileInfo(linkPath).fileName());
+            transaction.linkByTarget.insert(path, linkPath);
         }
+        success = _link(path, linkPath);
     }
 
     return success;
 }
 
-bool DbManager::_removeApplication(const QString &path)
+// Returns true if symlinkPath is a symlink whose target, once resolved, is one of
+// canonicalTargets; dangling symlinks resolve to an empty string
+static bool symlinkPointsTo(const QString &symlinkPath, const QSet<QString> &canonicalTargets)
+{
+    return QFileInfo(symlinkPath).isSymLink()
+            && canonicalTargets.contains(
+                    QFileInfo(QFileInfo(symlinkPath).symLinkTarget()).canonicalFilePath());
+}
+
+// Remove all symlinks from ~/.local/share/launch/Applications and the subdirectories
+// of ~/.local/share/launch/MIME that point to the given applications.
+// The index knows which symlinks point to each application; only applications that
+// are not in it are searched for, in a single pass over all symlinks
+bool DbManager::_removeApplications(const QStringList &paths)
 {
     bool success = false;
 
-    // Remove all symlinks from ~/.local/share/launch/Applications that point to
-    // the target
-    QDirIterator it(localShareLaunchApplicationsPath,
-                    QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-    while (it.hasNext()) {
-        QString symlinkPath = it.next();
-        if (QFileInfo(symlinkPath).isSymLink()
-            && QFileInfo(QFileInfo(symlinkPath).symLinkTarget()).canonicalFilePath()
-                    == QFileInfo(path).canonicalFilePath()) {
-            if (QFile::remove(symlinkPath)) {
-                qDebug() << "Removed symlink:" << symlinkPath;
-                success = true;
-            } else {
-                qDebug() << "Failed to remove symlink:" << symlinkPath;
-                QMessageBox msgBox;
-                msgBox.setIcon(QMessageBox::Critical);
-                msgBox.setText("Failed to remove symlink:" + symlinkPath);
-                msgBox.exec();
+    QStringList symlinkPaths;
+    QSet<QString> unindexedTargets;
+    const bool useIndex = _indexIsFresh();
+    for (const QString &path : paths) {
+        const QSet<QString> target = { QFileInfo(path).canonicalFilePath() };
+        int i = useIndex ? index.find(path) : -1;
+        if (i == -1) {
+            unindexedTargets.unite(target);
+            continue;
+        }
+        // The MIME symlinks may have been changed since the index was written
+        const QStringList links = index.links(i);
+        for (const QString &symlinkPath : links) {
+            if (symlinkPointsTo(symlinkPath, target)) {
+                symlinkPaths.append(symlinkPath);
             }
         }
     }
 
-    // Also remove it from all subdirectories of ~/.local/share/launch/MIME
-    // that contain a symlink to the target
-    QDirIterator it2(localShareLaunchMimePath,
-                     QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-    while (it2.hasNext()) {
-        QString mimeDir = it2.next();
-        if (QFileInfo(mimeDir).isDir()) {
-            QDirIterator it3(mimeDir,
-                             QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-            while (it3.hasNext()) {
-                QString symlinkPath = it3.next();
-                if (QFileInfo(symlinkPath).isSymLink()
-                    && QFileInfo(QFileInfo(symlinkPath).symLinkTarget()).canonicalFilePath()
-                            == QFileInfo(path).canonicalFilePath()) {
-                    if (QFile::remove(symlinkPath)) {
-                        qDebug() << "Removed symlink:" << symlinkPath;
-                        success = true;
-                    } else {
-                        qDebug() << "Failed to remove symlink:" << symlinkPath;
-                        QMessageBox msgBox;
-                        msgBox.setIcon(QMessageBox::Critical);
-                        msgBox.setText("Failed to remove symlink:" + symlinkPath);
-                        msgBox.exec();
+    if (!unindexedTargets.isEmpty()) {
+        QDirIterator it(localShareLaunchApplicationsPath,
+                        QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            QString symlinkPath = it.next();
+            if (symlinkPointsTo(symlinkPath, unindexedTargets)) {
+                symlinkPaths.append(symlinkPath);
+            }
+        }
+
+        QDirIterator it2(localShareLaunchMimePath,
+                         QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it2.hasNext()) {
+            QString mimeDir = it2.next();
+            if (QFileInfo(mimeDir).isDir()) {
+                QDirIterator it3(mimeDir,
+                                 QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+                while (it3.hasNext()) {
+                    QString symlinkPath = it3.next();
+                    if (symlinkPointsTo(symlinkPath, unindexedTargets)) {
+                        symlinkPaths.append(symlinkPath);
                     }
                 }
             }
         }
     }
 
+    symlinkPaths.removeDuplicates();
+    for (const QString &symlinkPath : qAsConst(symlinkPaths)) {
+        if (_unlink(symlinkPath)) {
+            success = true;
+        } else {
+            if (!GuiApplication::ensure()) {
+                continue;
+            }
+            QMessageBox msgBox;
+            msgBox.setIcon(QMessageBox::Critical);
+            msgBox.setText("Failed to remove symlink:" + symlinkPath);
+            msgBox.exec();
+        }
+    }
+
     return success;
 }
 
 QStringList DbManager::allApplications() const
+{
+    if (_indexIsFresh()) {
+        return index.paths();
+    }
+    return _scanApplications();
+}
+
+QStringList DbManager::_scanApplications() const
 {
 
     QStringList results;
 
     // Check all symlinks in ~/.local/share/launch/Applications and get their
-    // targets if they exist, delete them otherwise
+    // targets if they exist; dangling symlinks are left to collectGarbageIfDue()
     QDirIterator it(localShareLaunchApplicationsPath,
                     QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
     while (it.hasNext()) {
@@ -347,8 +898,6 @@ QStringList DbManager::allApplications() const
             QString target = QFileInfo(symlinkPath).symLinkTarget();
             if (QFileInfo(target).exists()) {
                 results.append(target);
-            } else {
-                handleNonExistingApplicationSymlink(symlinkPath);
             }
         }
     }
@@ -370,6 +919,10 @@ QStringList DbManager::allApplications() const
 
 unsigned int DbManager::_numberOfApplications() const
 {
+    if (_indexIsFresh()) {
+        return index.count();
+    }
+
     // Count the number of valid symlinks in
     // ~/.local/share/launch/Applications
     unsigned int count = 0;
@@ -381,8 +934,6 @@ unsigned int DbManager::_numberOfApplications() const
             QString target = QFileInfo(symlinkPath).symLinkTarget();
             if (QFileInfo(target).exists()) {
                 count++;
-            } else {
-                handleNonExistingApplicationSymlink(symlinkPath);
             }
         }
     }
@@ -400,34 +951,61 @@ bool DbManager::handleNonExistingApplicationSymlink(const QString &symlinkPath)
     // at the target path (e.g., newer versions) and if so, ask the user whether
     // they want to create a new symlink to the new location
     QFile::remove(symlinkPath);
+    _invalidateIndex();
     return true;
 }
 
 bool DbManager::applicationExists(const QString &path) const
 {
+    if (_indexIsFresh()) {
+        return index.find(path) != -1;
+    }
+
     bool exists = false;
     // Check all symlinks in ~/.local/share/launch/Applications and get their
-    // targets if they exist, delete them otherwise. If the target of a symlink
-    // matches the path, the application exists
+    // targets. If the target of a symlink matches the path and exists, the
+    // application exists
     QDirIterator it(localShareLaunchApplicationsPath,
                     QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
     while (it.hasNext()) {
         QString symlinkPath = it.next();
         if (QFileInfo(symlinkPath).isSymLink()) {
             QString target = QFileInfo(symlinkPath).symLinkTarget();
-            if (QFileInfo(target).exists()) {
-                if (target == path) {
-                    exists = true;
-                    break;
-                }
-            } else {
-                handleNonExistingApplicationSymlink(symlinkPath);
+            if (target == path && QFileInfo(target).exists()) {
+                exists = true;
+                break;
             }
         }
     }
     return exists;
 }
 
+// Look up the applications with the given name in the index, the preferred one first.
+// Returns false if the index cannot be used
+bool DbManager::applicationsForName(const QString &name, QStringList &applications) const
+{
+    if (!_indexIsFresh()) {
+        return false;
+    }
+    applications = index.applicationsForName(name);
+    return true;
+}
+
+// Look up the applications that can open mimeType, and those that can open any MIME
+// type with the same part before the '/', in the index.
+// Returns false if the index cannot be used, in which case the caller has to
+// check the "can-open" of all applications itself
+bool DbManager::handlersForMimeType(const QString &mimeType, QStringList &handlers,
+                                    QStringList &fallbackHandlers) const
+{
+    if (!_indexIsFresh()) {
+        return false;
+    }
+    handlers = index.handlersForMimeType(mimeType);
+    fallbackHandlers = index.handlersForMediaType(mimeType.split("/").first());
+    return true;
+}
+
 bool DbManager::removeAllApplications()
 {
     bool success = false;
@@ -440,7 +1018,10 @@ bool DbManager::removeAllApplications()
         if (QFileInfo(symlinkPath).isSymLink()) {
             qDebug() << "Removing symlink:" << symlinkPath;
             QFile::remove(symlinkPath);
+            _invalidateIndex();
         }
     }
+    linksByApplication.clear();
+    linksKnown = false;
     return success;
 }
@@ -1,29 +1,100 @@
 #ifndef DBMANAGER_H
 #define DBMANAGER_H
 
+#include <QHash>
+#include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "ApplicationIndex.h"
 
 class DbManager
 {
 public:
-    DbManager();
+    /**
+     * What removeDanglingSymlinks() has done.
+     */
+    struct GarbageCollectionStats
+    {
+        int checkedLinks = 0;
+        int removedApplicationLinks = 0;
+        int removedMimeLinks = 0;
+        int removedMimeDirectories = 0;
+        qint64 msecs = 0;
+    };
+
+    DbManager(bool collectGarbage = true);
     ~DbManager();
+    GarbageCollectionStats removeDanglingSymlinks() const;
+    bool collectGarbageIfDue() const;
+    static QString garbageCollectionStampPath();
     void handleApplication(QString canonicalPath);
+    void handleApplications(const QStringList &paths);
     QStringList allApplications() const;
     bool removeAllApplications();
     bool handleNonExistingApplicationSymlink(const QString &symlinkPath) const;
     bool applicationExists(const QString &name) const;
+    bool applicationsForName(const QString &name, QStringList &applications) const;
+    bool handlersForMimeType(const QString &mimeType, QStringList &handlers,
+                             QStringList &fallbackHandlers) const;
     QString getCanOpenFromFile(QString canonicalPath);
-    bool filesystemSupportsExtattr;
+    void begin();
+    bool commit();
+    bool writeIndex(bool rebuild = false);
+    bool filesystemSupportsExtattr(const QString &path) const;
     static const QString localShareLaunchApplicationsPath;
     static const QString localShareLaunchMimePath;
 
 private:
+    /**
+     * A change to the symlinks of the launch database.
+     */
+    struct Operation
+    {
+        enum Kind : quint8 { Link, Unlink };
+        Kind kind;
+        QString target; /**< What a new symlink points to. */
+        QString path; /**< The symlink. */
+    };
+
+    /**
+     * The state of the launch database as it will be after commit().
+     */
+    struct Transaction
+    {
+        QHash<QString, QString> linkByTarget; /**< Symlink in Applications per target. */
+        QSet<QString> applicationNames; /**< File names in Applications. */
+        QHash<QString, QSet<QString>> mimeLinks; /**< File names per MIME directory, lazily. */
+        QVector<Operation> operations;
+    };
+
+    static QString _databasePath();
+    static QString _journalPath(qint64 pid);
+    bool _writeJournal(const QString &journalPath, const QVector<Operation> &operations) const;
+    void _replayJournals();
+    bool _applyOperations(const QVector<Operation> &operations);
+    bool _link(const QString &target, const QString &linkPath);
+    bool _unlink(const QString &symlinkPath);
+    QSet<QString> &_mimeLinks(const QString &mimeDir);
     bool _createTable();
     bool _addApplication(const QString &name);
-    bool _removeApplication(const QString &name);
+    bool _handleExistingApplication(const QString &canonicalPath);
+    bool _removeApplications(const QStringList &paths);
+    QStringList _scanApplications() const;
+    QHash<QString, QStringList> _scanLinks(const QSet<QString> &applications) const;
+    bool _indexIsFresh() const;
+    void _invalidateIndex() const;
 
     unsigned int _numberOfApplications() const;
+
+    bool collectGarbage;
+    bool inTransaction;
+    Transaction transaction;
+    mutable ApplicationIndex index;
+    mutable bool indexChecked;
+    QHash<QString, QStringList> linksByApplication; /**< Symlinks per application. */
+    bool linksKnown; /**< Whether linksByApplication is up to date. */
 };
 
 #endif // DBMANAGER_H
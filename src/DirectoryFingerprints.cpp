@@ -0,0 +1,168 @@
+#include "DirectoryFingerprints.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <sys/stat.h>
+
+static const quint32 FINGERPRINTS_MAGIC = 0x4c444650; // "LDFP"
+static const quint32 FINGERPRINTS_VERSION = 2;
+
+// Filesystems with coarse timestamps (e.g., FAT, some network filesystems) may not change
+// the modification time of a directory that was modified within the same second in which
+// it was scanned. Fingerprints taken that close to a modification are not trusted.
+static const qint64 TIMESTAMP_GRANULARITY_NS = 2000000000LL;
+
+static QDataStream &operator<<(QDataStream &out, const DirectoryFingerprint &fingerprint)
+{
+    out << fingerprint.mtimeNs << fingerprint.device << fingerprint.inode
+        << fingerprint.entryCount << fingerprint.scannedAtNs << fingerprint.subdirectories;
+    return out;
+}
+
+static QDataStream &operator>>(QDataStream &in, DirectoryFingerprint &fingerprint)
+{
+    in >> fingerprint.mtimeNs >> fingerprint.device >> fingerprint.inode
+            >> fingerprint.entryCount >> fingerprint.scannedAtNs >> fingerprint.subdirectories;
+    return in;
+}
+
+DirectoryFingerprints::DirectoryFingerprints(const QString &storePath)
+    : storePath(storePath), dirty(false)
+{
+    load();
+}
+
+DirectoryFingerprints::~DirectoryFingerprints() { }
+
+QString DirectoryFingerprints::defaultStorePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/directory-fingerprints";
+}
+
+bool DirectoryFingerprints::currentFingerprint(const QString &directory,
+                                               DirectoryFingerprint &fingerprint)
+{
+    struct stat st;
+    if (stat(QFile::encodeName(directory).constData(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    fingerprint.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    fingerprint.device = st.st_dev;
+    fingerprint.inode = st.st_ino;
+    return true;
+}
+
+bool DirectoryFingerprints::isStable(const DirectoryFingerprint &fingerprint)
+{
+    return QDateTime::currentMSecsSinceEpoch() * 1000000LL - fingerprint.mtimeNs
+            >= TIMESTAMP_GRANULARITY_NS;
+}
+
+bool DirectoryFingerprints::isUnchanged(const QString &directory,
+                                        const DirectoryFingerprint &current,
+                                        DirectoryFingerprint &stored) const
+{
+    auto it = fingerprints.constFind(directory);
+    if (it == fingerprints.constEnd()) {
+        return false;
+    }
+    if (it->mtimeNs != current.mtimeNs || it->device != current.device
+        || it->inode != current.inode) {
+        return false;
+    }
+    if (it->scannedAtNs - it->mtimeNs < TIMESTAMP_GRANULARITY_NS) {
+        return false;
+    }
+    stored = *it;
+    return true;
+}
+
+void DirectoryFingerprints::update(const QString &directory,
+                                   const DirectoryFingerprint &fingerprint)
+{
+    DirectoryFingerprint recorded = fingerprint;
+    recorded.scannedAtNs = QDateTime::currentMSecsSinceEpoch() * 1000000LL;
+    fingerprints.insert(directory, recorded);
+    dirty = true;
+}
+
+void DirectoryFingerprints::bindToDatabase(const QString &applicationsPath)
+{
+    databasePath = applicationsPath;
+    if (fingerprints.isEmpty()) {
+        return;
+    }
+    // Not isUnchanged(): the database is usually modified right before the store is
+    // saved, so the "too recent" rule would discard the store after every change
+    DirectoryFingerprint current;
+    const auto recorded = fingerprints.constFind(applicationsPath);
+    if (recorded != fingerprints.constEnd()
+        && DirectoryFingerprints::currentFingerprint(applicationsPath, current)
+        && current.device == recorded->device && current.inode == recorded->inode
+        && current.mtimeNs == recorded->mtimeNs) {
+        return;
+    }
+    qDebug() << "Discarding directory fingerprints because" << applicationsPath
+             << "has changed";
+    fingerprints.clear();
+    dirty = true;
+}
+
+bool DirectoryFingerprints::load()
+{
+    QFile f(storePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != FINGERPRINTS_MAGIC || version != FINGERPRINTS_VERSION) {
+        qDebug() << "Ignoring fingerprints in unknown format at" << storePath;
+        return false;
+    }
+    in >> fingerprints;
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring corrupt fingerprints at" << storePath;
+        fingerprints.clear();
+        return false;
+    }
+    qDebug() << "Loaded" << fingerprints.size() << "directory fingerprints from" << storePath;
+    return true;
+}
+
+bool DirectoryFingerprints::save()
+{
+    // Record the state of the launch database that the fingerprints belong to
+    DirectoryFingerprint database;
+    if (dirty && !databasePath.isEmpty()
+        && DirectoryFingerprints::currentFingerprint(databasePath, database)) {
+        update(databasePath, database);
+    }
+    if (!dirty) {
+        return true;
+    }
+    QDir().mkpath(QFileInfo(storePath).path());
+    QSaveFile f(storePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write directory fingerprints to" << storePath;
+        return false;
+    }
+    QDataStream out(&f);
+    out << FINGERPRINTS_MAGIC << FINGERPRINTS_VERSION << fingerprints;
+    if (!f.commit()) {
+        qDebug() << "Cannot write directory fingerprints to" << storePath;
+        return false;
+    }
+    dirty = false;
+    return true;
+}
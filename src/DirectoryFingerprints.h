@@ -0,0 +1,120 @@
+#ifndef DIRECTORYFINGERPRINTS_H
+#define DIRECTORYFINGERPRINTS_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @file DirectoryFingerprints.h
+ * @brief Persisted per-directory fingerprints used to skip unchanged directories
+ * during application discovery.
+ */
+
+/**
+ * The state of a directory at the time it was last scanned.
+ */
+struct DirectoryFingerprint
+{
+    qint64 mtimeNs = 0; /**< Modification time of the directory in nanoseconds. */
+    quint64 device = 0; /**< Device on which the directory resides. */
+    quint64 inode = 0; /**< Inode number of the directory. */
+    quint32 entryCount = 0; /**< Number of applications found directly in the directory. */
+    qint64 scannedAtNs = 0; /**< Time at which the directory was scanned. */
+    QStringList subdirectories; /**< Non-bundle subdirectories that were descended into. */
+};
+
+/**
+ * @class DirectoryFingerprints
+ * @brief A store of directory fingerprints that persists across invocations.
+ *
+ * A directory whose modification time and inode are the same as when it was last
+ * scanned has not gained or lost any entries, so its entries do not need to be
+ * listed again. Only its recorded subdirectories need to be checked.
+ */
+class DirectoryFingerprints
+{
+public:
+    /**
+     * Constructor. Loads the store from disk if it exists.
+     *
+     * @param storePath The path of the file in which the fingerprints are persisted.
+     */
+    explicit DirectoryFingerprints(const QString &storePath = defaultStorePath());
+
+    /**
+     * Destructor.
+     */
+    ~DirectoryFingerprints();
+
+    /**
+     * @return The default location of the store, ~/.cache/launch/directory-fingerprints
+     */
+    static QString defaultStorePath();
+
+    /**
+     * Get the current fingerprint of a directory using a single stat call.
+     *
+     * @param directory The directory to fingerprint.
+     * @param fingerprint Receives the modification time, device and inode of the directory.
+     * @return False if the directory does not exist or cannot be accessed.
+     */
+    static bool currentFingerprint(const QString &directory, DirectoryFingerprint &fingerprint);
+
+    /**
+     * Check whether a fingerprint can be trusted to change with the next modification of
+     * the directory. On filesystems with coarse timestamps, a modification made shortly
+     * after another one may not change the modification time.
+     *
+     * @param fingerprint A fingerprint as returned by currentFingerprint().
+     * @return False if the directory has been modified too recently.
+     */
+    static bool isStable(const DirectoryFingerprint &fingerprint);
+
+    /**
+     * Check whether a directory is unchanged since it was last scanned.
+     *
+     * @param directory The directory to check.
+     * @param current The current fingerprint as returned by currentFingerprint().
+     * @param stored Receives the stored fingerprint if the directory is unchanged.
+     * @return True if the directory does not need to be scanned again.
+     */
+    bool isUnchanged(const QString &directory, const DirectoryFingerprint &current,
+                     DirectoryFingerprint &stored) const;
+
+    /**
+     * Record the fingerprint of a directory that has just been scanned.
+     */
+    void update(const QString &directory, const DirectoryFingerprint &fingerprint);
+
+    /**
+     * Tie the store to the launch database that the scanned applications are added to.
+     *
+     * An unchanged directory can only be skipped if its applications are still in the
+     * launch database. If the symlink directory of the database has changed since the
+     * store was saved, i.e., its device, inode or modification time differs from the
+     * recorded ones, e.g., because it has been wiped or symlinks have been removed,
+     * all fingerprints are discarded. The fingerprint of the symlink directory is
+     * recorded again when the store is saved.
+     *
+     * @param applicationsPath The symlink directory of the launch database.
+     */
+    void bindToDatabase(const QString &applicationsPath);
+
+    /**
+     * Write the store to disk if it has changed.
+     *
+     * @return True on success or if there was nothing to write.
+     */
+    bool save();
+
+private:
+    bool load();
+
+    QString storePath;
+    QString databasePath; /**< The symlink directory of the launch database, if bound. */
+    QHash<QString, DirectoryFingerprint> fingerprints;
+    bool dirty;
+};
+
+#endif // DIRECTORYFINGERPRINTS_H
@@ -1,49 +1,120 @@
 #include "Executable.h"
 #include <QFileInfo>
 #include <QFile>
+#include <QHash>
 #include <QTextStream>
-#include <QMimeDatabase>
 #include <QDebug>
 #include <QMessageBox>
 #include <QProcess>
 
+#include "MimeSniffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 bool Executable::isExecutable(const QString& path) {
     QFileInfo fileInfo(path);
     return fileInfo.isExecutable();
 }
 
-bool Executable::hasShebang(const QString& path) {
-    QFile file(path);
-    QFileInfo fileInfo(path);
+// Enough for the ELF program headers of most executables and for the GPT header
+static const int CLASSIFY_HEADER_SIZE = 1024;
 
-    // If it is a directory, it cannot have a shebang, so return false
-    if (fileInfo.isDir()) {
-        qDebug() << "File is a directory, so it cannot have a shebang.";
+static quint64 readUnsigned(const uchar *data, int size, bool bigEndian) {
+    quint64 value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= quint64(data[bigEndian ? i : size - 1 - i]) << (8 * (size - 1 - i));
+    }
+    return value;
+}
+
+// Look for a PT_INTERP program header, which executables have and shared libraries
+// do not; returns false if the program headers are not within the header
+static bool elfHasInterpreter(const QByteArray &header, bool &known) {
+    const uchar *data = reinterpret_cast<const uchar *>(header.constData());
+    const bool is64Bit = data[4] == 2;
+    const bool bigEndian = data[5] == 2;
+    known = false;
+    if (header.size() < (is64Bit ? 64 : 52)) {
         return false;
     }
+    quint64 phoff = is64Bit ? readUnsigned(data + 32, 8, bigEndian)
+                            : readUnsigned(data + 28, 4, bigEndian);
+    quint64 phentsize = readUnsigned(data + (is64Bit ? 54 : 42), 2, bigEndian);
+    quint64 phnum = readUnsigned(data + (is64Bit ? 56 : 44), 2, bigEndian);
+    // phoff comes from the file and may be anything, so do not add to it
+    const quint64 size = quint64(header.size());
+    if (phentsize < 4 || phoff > size || phentsize * phnum > size - phoff) {
+        return false;
+    }
+    known = true;
+    for (quint64 i = 0; i < phnum; i++) {
+        if (readUnsigned(data + phoff + i * phentsize, 4, bigEndian) == 3) { // PT_INTERP
+            return true;
+        }
+    }
+    return false;
+}
+
+FileKind Executable::classify(const QString& path) {
+    static QHash<QString, FileKind> cache;
+    auto it = cache.constFind(path);
+    if (it != cache.constEnd()) {
+        return *it;
+    }
+
+    FileKind kind;
+    int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        kind.exists = true;
+        QByteArray header(CLASSIFY_HEADER_SIZE, Qt::Uninitialized);
+        ssize_t length = pread(fd, header.data(), header.size(), 0);
+        if (length == -1 && errno == EISDIR) {
+            kind.isDirectory = true;
+            length = 0;
+        }
+        close(fd);
+        header.truncate(int(qMax(ssize_t(0), length)));
 
-    // If it is a symlink, we need to check the target
-    if (fileInfo.isSymLink()) {
-        qDebug() << "File is a symlink, so we need to check the target.";
-        QString target = fileInfo.symLinkTarget();
-        qDebug() << "Target:" << target;
-        return hasShebang(target);
+        kind.hasShebang = header.startsWith("#!");
+        if (header.startsWith("\x7f" "ELF") && header.size() >= 18) {
+            kind.isElf = true;
+            const uchar *data = reinterpret_cast<const uchar *>(header.constData());
+            kind.elfType = quint16(readUnsigned(data + 16, 2, data[5] == 2));
+            kind.hasInterpreter = elfHasInterpreter(header, kind.programHeadersRead);
+            // AppImages have "AI" and their type at offset 8
+            if (data[8] == 'A' && data[9] == 'I' && (data[10] == 1 || data[10] == 2)) {
+                kind.appImageType = data[10];
+            }
+        }
+        if ((header.size() >= 512 && uchar(header.at(510)) == 0x55
+             && uchar(header.at(511)) == 0xaa)
+            || header.mid(512, 8) == "EFI PART") {
+            kind.isDiskImage = true;
+        }
     }
 
-    qDebug() << "Checking file:" << path;
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    cache.insert(path, kind);
+    return kind;
+}
+
+bool Executable::hasShebang(const QString& path) {
+    FileKind kind = classify(path);
+    if (kind.isDirectory) {
+        qDebug() << "File is a directory, so it cannot have a shebang.";
+        return false;
+    }
+    if (!kind.exists) {
         qWarning() << "Failed to open file:" << path;
         return false;
     }
-
-    // Check if the file starts with the shebang sequence
-    QByteArray firstTwoBytes = file.read(2);
-    qDebug() << "First two bytes:" << firstTwoBytes;
-    if (firstTwoBytes == "#!") {
+    if (kind.hasShebang) {
         qDebug() << "File has a shebang.";
-        // Exception: If the MIME type is e.g., "application/x-raw-disk-image",
+        // Exception: If the file is a disk image, e.g., "application/x-raw-disk-image",
         // then we ignore the shebang
-        if (QMimeDatabase().mimeTypeForFile(path).name().contains("disk-image")) {
+        if (kind.isDiskImage || MimeSniffer::mimeTypeForFileName(QFileInfo(path).fileName())
+                                        .contains("disk-image")) {
             qDebug() << "File is a disk image, so we ignore the shebang.";
             return false;
         }
@@ -55,19 +126,32 @@ bool Executable::hasShebang(const QString& path) {
 }
 
 bool Executable::isElf(const QString& path) {
-    QMimeDatabase mimeDatabase;
-    QString mimeType = mimeDatabase.mimeTypeForFile(path).name();
-    // NOTE: Not all "application/..." mime types are ELF executables, e.g., disk images
-    // have "application/..." mime types, too.
-    if (mimeType == "application/x-executable" || \
-        mimeType == "application/x-pie-executable" || \
-        mimeType == "application/vnd-appimage") {
+    FileKind kind = classify(path);
+    // NOTE: Not all ELF files are executables, e.g., shared libraries are ELF files, too.
+    // Executables are of type ET_EXEC, or of type ET_DYN with an interpreter if they are
+    // position-independent; AppImages are executables, too.
+    if (kind.isElf && kind.elfType == 2) {
         qDebug() << "File is an ELF executable.";
         return true;
-    } else {
-        qDebug() << "File is not an ELF executable.";
-        return false;
     }
+    if (kind.isElf && kind.elfType == 3) {
+        if (kind.hasInterpreter || kind.appImageType != 0) {
+            qDebug() << "File is an ELF executable.";
+            return true;
+        }
+        if (!kind.programHeadersRead) {
+            // The program headers are not within the first bytes, so let the MIME type decide
+            QString mimeType = MimeSniffer::mimeTypeForFile(path);
+            if (mimeType == "application/x-executable" ||
+                mimeType == "application/x-pie-executable" ||
+                mimeType == "application/vnd-appimage") {
+                qDebug() << "File is an ELF executable.";
+                return true;
+            }
+        }
+    }
+    qDebug() << "File is not an ELF executable.";
+    return false;
 }
 
 bool Executable::askUserToMakeExecutable(const QString& path) {
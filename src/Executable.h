@@ -4,6 +4,21 @@
 #include <QString>
 #include <QObject>
 
+/**
+ * What the first bytes of a file say about it.
+ */
+struct FileKind {
+    bool exists = false; /**< The file could be opened. */
+    bool isDirectory = false;
+    bool isElf = false; /**< The file starts with the ELF magic. */
+    quint16 elfType = 0; /**< e_type of an ELF file, e.g., 2 for ET_EXEC, 3 for ET_DYN. */
+    bool hasInterpreter = false; /**< An ELF file with a PT_INTERP program header. */
+    bool programHeadersRead = false; /**< The ELF program headers were within the bytes read. */
+    bool hasShebang = false; /**< The file starts with "#!". */
+    int appImageType = 0; /**< 1 or 2 for AppImages, 0 otherwise. */
+    bool isDiskImage = false; /**< The file has an MBR boot signature or a GPT header. */
+};
+
 /**
  * @file Executable.h
  * @class Executable
@@ -44,6 +59,16 @@ public:
      */
     static bool isElf(const QString& path);
 
+    /**
+     * Classify a file by reading its first bytes with a single open and pread.
+     * The result is cached for the lifetime of the process, so classifying the same
+     * path again does not access the file.
+     *
+     * @param path The path to the file; symlinks are followed.
+     * @return What kind of file it is.
+     */
+    static FileKind classify(const QString& path);
+
     /**
      * @brief Ask the user if they want to make a file executable and perform the action if requested.
      *
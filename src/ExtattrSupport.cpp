@@ -0,0 +1,172 @@
+#include "ExtattrSupport.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <sys/param.h> // for checking BSD definition
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(BSD)
+#  include <sys/extattr.h>
+#  include <sys/mount.h>
+#  include <sys/ucred.h>
+#else
+#  include <sys/types.h>
+#  include <sys/xattr.h>
+#endif
+
+static const quint32 EXTATTR_SUPPORT_MAGIC = 0x4c584154; // "LXAT"
+static const quint32 EXTATTR_SUPPORT_VERSION = 2;
+
+// Set and removed again right away
+static const char PROBE_ATTRIBUTE[] = "launch-probe";
+
+ExtattrSupport::ExtattrSupport() : storePath(defaultStorePath())
+{
+    mountFingerprint = mountTableFingerprint();
+    load();
+}
+
+ExtattrSupport &ExtattrSupport::instance()
+{
+    static ExtattrSupport support;
+    return support;
+}
+
+QString ExtattrSupport::defaultStorePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/extattr-support";
+}
+
+// Changes whenever a filesystem is mounted, unmounted or remounted
+QByteArray ExtattrSupport::mountTableFingerprint()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+#if defined(BSD)
+    struct statfs *mounts = nullptr;
+    int count = getmntinfo(&mounts, MNT_NOWAIT);
+    for (int i = 0; i < count; i++) {
+        hash.addData(mounts[i].f_mntfromname, int(qstrlen(mounts[i].f_mntfromname)) + 1);
+        hash.addData(mounts[i].f_mntonname, int(qstrlen(mounts[i].f_mntonname)) + 1);
+        hash.addData(mounts[i].f_fstypename, int(qstrlen(mounts[i].f_fstypename)) + 1);
+        hash.addData(reinterpret_cast<const char *>(&mounts[i].f_fsid), sizeof(mounts[i].f_fsid));
+    }
+#else
+    // Contains the mount IDs and device numbers, so remounts change it as well
+    QFile mountinfo("/proc/self/mountinfo");
+    if (mountinfo.open(QIODevice::ReadOnly)) {
+        hash.addData(mountinfo.readAll());
+    }
+#endif
+    return hash.result();
+}
+
+// Reading alone is not enough: on filesystems that support extended attributes, setting
+// them fails with EACCES or EPERM for files that belong to other users
+bool ExtattrSupport::probe(const QString &path)
+{
+    const QByteArray encodedPath = QFile::encodeName(path);
+    const char value = '1';
+#if defined(BSD)
+    if (extattr_set_file(encodedPath.constData(), EXTATTR_NAMESPACE_USER, PROBE_ATTRIBUTE,
+                         &value, sizeof(value))
+        < 0) {
+        return false;
+    }
+    extattr_delete_file(encodedPath.constData(), EXTATTR_NAMESPACE_USER, PROBE_ATTRIBUTE);
+#else
+    const QByteArray name = QByteArray("user.") + PROBE_ATTRIBUTE;
+    if (setxattr(encodedPath.constData(), name.constData(), &value, sizeof(value), 0) != 0) {
+        return false;
+    }
+    removexattr(encodedPath.constData(), name.constData());
+#endif
+    return true;
+}
+
+bool ExtattrSupport::isSupported(const QString &path)
+{
+    struct stat st;
+    if (stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return false;
+    }
+
+    ExtattrSupport &support = instance();
+    const QPair<quint64, bool> key = qMakePair(quint64(st.st_dev), st.st_uid == getuid());
+    auto it = support.supportedByDevice.constFind(key);
+    if (it != support.supportedByDevice.constEnd()) {
+        return *it;
+    }
+
+    const bool supported = probe(path);
+    qDebug() << "Extended attributes" << (supported ? "can" : "cannot")
+             << "be set on files like" << path;
+    support.supportedByDevice.insert(key, supported);
+    support.save();
+    return supported;
+}
+
+void ExtattrSupport::reload()
+{
+    ExtattrSupport &support = instance();
+    const QByteArray fingerprint = mountTableFingerprint();
+    if (fingerprint != support.mountFingerprint) {
+        qDebug() << "The mount table has changed; probing filesystems again";
+        support.mountFingerprint = fingerprint;
+        support.supportedByDevice.clear();
+    }
+}
+
+bool ExtattrSupport::load()
+{
+    QFile f(storePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray fingerprint;
+    in >> magic >> version >> fingerprint;
+    if (magic != EXTATTR_SUPPORT_MAGIC || version != EXTATTR_SUPPORT_VERSION
+        || in.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring extended attribute support cache in unknown format at" << storePath;
+        return false;
+    }
+    if (fingerprint != mountFingerprint) {
+        qDebug() << "The mount table has changed; ignoring" << storePath;
+        return false;
+    }
+    in >> supportedByDevice;
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring corrupt extended attribute support cache at" << storePath;
+        supportedByDevice.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ExtattrSupport::save() const
+{
+    QDir().mkpath(QFileInfo(storePath).path());
+    QSaveFile f(storePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write extended attribute support cache to" << storePath;
+        return false;
+    }
+    QDataStream out(&f);
+    out << EXTATTR_SUPPORT_MAGIC << EXTATTR_SUPPORT_VERSION << mountFingerprint
+        << supportedByDevice;
+    if (!f.commit()) {
+        qDebug() << "Cannot write extended attribute support cache to" << storePath;
+        return false;
+    }
+    return true;
+}
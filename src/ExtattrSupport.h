@@ -0,0 +1,62 @@
+#ifndef EXTATTRSUPPORT_H
+#define EXTATTRSUPPORT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QString>
+
+/**
+ * @file ExtattrSupport.h
+ * @class ExtattrSupport
+ * @brief Remembers which filesystems support extended attributes.
+ *
+ * Extended attributes are used to store, e.g., the MIME types an application can open,
+ * but reading them is wasted effort on filesystems that do not support them, such as
+ * those of some Live ISOs, and applications whose attributes cannot be set must get
+ * their MIME types from elsewhere. Whether attributes are supported is found out by
+ * setting and removing an attribute once, so "supported" means that this user can set
+ * them. Files of this user and files of other users, e.g., in /usr, are probed
+ * separately, because the latter can usually not be written to.
+ *
+ * The result is kept per device (st_dev) and owner in ~/.cache/launch/extattr-support
+ * together with a fingerprint of the mount table; whenever filesystems are mounted or
+ * unmounted, the device numbers may refer to different filesystems, so all results are
+ * discarded.
+ */
+class ExtattrSupport
+{
+public:
+    /**
+     * @param path A file or directory, e.g., an application bundle.
+     * @return True if extended attributes can be set on files like path: those on the
+     * same filesystem that belong to the same user.
+     */
+    static bool isSupported(const QString &path);
+
+    /**
+     * Discard the results if the mount table has changed since they were obtained.
+     * Long-lived processes call this periodically.
+     */
+    static void reload();
+
+    /**
+     * @return The location of the cache, ~/.cache/launch/extattr-support
+     */
+    static QString defaultStorePath();
+
+private:
+    ExtattrSupport();
+    static ExtattrSupport &instance();
+    static QByteArray mountTableFingerprint();
+    static bool probe(const QString &path);
+
+    bool load();
+    bool save() const;
+
+    QString storePath;
+    QByteArray mountFingerprint;
+    QHash<QPair<quint64, bool>, bool> supportedByDevice; /**< By device and whether owned. */
+};
+
+#endif // EXTATTRSUPPORT_H
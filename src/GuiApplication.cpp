@@ -0,0 +1,40 @@
+#include "GuiApplication.h"
+
+#include <QApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+
+int *GuiApplication::argc = nullptr;
+char **GuiApplication::argv = nullptr;
+
+void GuiApplication::setArguments(int &argc, char **argv)
+{
+    GuiApplication::argc = &argc;
+    GuiApplication::argv = argv;
+}
+
+bool GuiApplication::ensure()
+{
+    QCoreApplication *app = QCoreApplication::instance();
+    if (qobject_cast<QApplication *>(app)) {
+        return true;
+    }
+    if (app) {
+        qDebug() << "Cannot show widgets in a QCoreApplication";
+        return false;
+    }
+
+    static int fallbackArgc = 1;
+    static char fallbackName[] = "launch";
+    static char *fallbackArgv[] = { fallbackName, nullptr };
+    if (!argc) {
+        argc = &fallbackArgc;
+        argv = fallbackArgv;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    new QApplication(*argc, argv);
+    qDebug() << "Took" << timer.elapsed() << "milliseconds to bring up the GUI";
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef GUIAPPLICATION_H
+#define GUIAPPLICATION_H
+
+/**
+ * @file GuiApplication.h
+ * @class GuiApplication
+ * @brief Brings up the widget stack only when something needs to be shown.
+ *
+ * Most invocations of 'launch' and 'open' resolve an application, start it and exit
+ * without ever showing a window. Constructing a QApplication connects to the X server
+ * and loads the platform plugin, style and fonts, which is a large part of the startup
+ * time and memory use. Hence the tools run without any application object, and a
+ * QApplication is constructed the first time a message box or dialog is about to be
+ * shown.
+ *
+ * Qt does not support replacing the application object of a running process, so there
+ * is never more than one. Everything that runs before a QApplication may be needed
+ * must therefore work without one: talking to the launch daemon uses a plain Unix domain
+ * socket, and talking to Menu uses libdbus rather than QtDBus.
+ */
+class GuiApplication
+{
+public:
+    /**
+     * Remember the arguments for the QApplication that ensure() may construct.
+     *
+     * @param argc The argument count passed to main(); must outlive the application.
+     * @param argv The arguments passed to main().
+     */
+    static void setArguments(int &argc, char **argv);
+
+    /**
+     * Make sure that a QApplication exists, constructing it if there is no application
+     * object yet.
+     *
+     * @return False if widgets cannot be used because the process already has an
+     * application object that is not a QApplication, e.g., the one of the launch daemon.
+     */
+    static bool ensure();
+
+private:
+    static int *argc;
+    static char **argv;
+};
+
+#endif // GUIAPPLICATION_H
@@ -0,0 +1,271 @@
+#include "LaunchDaemon.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ApplicationWatcher.h"
+#include "ExtattrSupport.h"
+#include "ProcessSpawner.h"
+#include "launcher.h"
+
+static const quint32 PROTOCOL_VERSION = 1;
+
+// How long clients wait for the daemon before falling back to doing the work in-process
+static const int CONNECT_TIMEOUT_MS = 50;
+static const int REPLY_TIMEOUT_MS = 1000;
+
+// How often the daemon looks for applications that have been added or removed
+// if not all application locations can be watched
+static const int REFRESH_INTERVAL_MS = 60 * 1000;
+
+// How often the daemon looks for changes that watching does not catch, e.g., applications
+// outside of the application locations that have been deleted
+static const int WATCHED_REFRESH_INTERVAL_MS = 60 * 60 * 1000;
+
+LaunchDaemon::LaunchDaemon(QObject *parent)
+    : QObject(parent),
+      server(new QLocalServer(this)),
+      refreshTimer(new QTimer(this)),
+      launcher(new Launcher()),
+      watcher(new ApplicationWatcher(launcher->database(), this)),
+      rediscoveryScheduled(false)
+{
+    connect(server, &QLocalServer::newConnection, this, &LaunchDaemon::handleConnection);
+    connect(refreshTimer, &QTimer::timeout, this, &LaunchDaemon::refresh);
+}
+
+LaunchDaemon::~LaunchDaemon()
+{
+    delete launcher;
+}
+
+QString LaunchDaemon::socketPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + "/launch-daemon";
+}
+
+bool LaunchDaemon::listen()
+{
+    if (isAvailable()) {
+        qCritical() << "Another launch daemon is already listening on" << socketPath();
+        return false;
+    }
+
+    launcher->discoverApplications();
+
+    // A socket left behind by a daemon that did not exit cleanly would prevent listening
+    QLocalServer::removeServer(socketPath());
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(socketPath())) {
+        qCritical() << "Cannot listen on" << socketPath() << server->errorString();
+        return false;
+    }
+    qDebug() << "Launch daemon listening on" << socketPath();
+
+    AppDiscovery discovery(launcher->database());
+    if (watcher->watch(discovery.wellKnownApplicationLocations())) {
+        refreshTimer->start(WATCHED_REFRESH_INTERVAL_MS);
+    } else {
+        qDebug() << "Not all application locations can be watched; refreshing periodically";
+        refreshTimer->start(REFRESH_INTERVAL_MS);
+    }
+    return true;
+}
+
+void LaunchDaemon::refresh()
+{
+    ExtattrSupport::reload();
+    launcher->database()->removeDanglingSymlinks();
+    launcher->discoverApplications();
+    ProcessSpawner::cleanUpStandardErrorFiles();
+}
+
+void LaunchDaemon::handleConnection()
+{
+    while (server->hasPendingConnections()) {
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            handleRequest(socket);
+        });
+    }
+}
+
+void LaunchDaemon::handleRequest(QLocalSocket *socket)
+{
+    QDataStream in(socket);
+    quint32 version = 0;
+    QString command;
+    QStringList args;
+
+    // Wait until the complete request has arrived
+    in.startTransaction();
+    in >> version >> command >> args;
+    if (!in.commitTransaction()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString bundlePath;
+    if (version != PROTOCOL_VERSION) {
+        qDebug() << "Ignoring request with unknown protocol version" << version;
+    } else if (command == "resolve" && !args.isEmpty()) {
+        bundlePath = launcher->bundleForName(args.first());
+        if (bundlePath.isEmpty() && !rediscoveryScheduled) {
+            // The application may have been installed somewhere that is not watched.
+            // Look for it after answering, so that this and other clients do not wait
+            rediscoveryScheduled = true;
+            QTimer::singleShot(0, this, [this]() {
+                rediscoveryScheduled = false;
+                launcher->discoverApplications();
+            });
+        }
+    } else {
+        qDebug() << "Ignoring unknown request" << command;
+    }
+
+    qDebug() << "Resolved" << args << "to" << bundlePath << "in" << timer.elapsed()
+             << "milliseconds";
+
+    QByteArray reply;
+    QDataStream out(&reply, QIODevice::WriteOnly);
+    out << PROTOCOL_VERSION << bundlePath;
+    socket->write(reply);
+    socket->flush();
+    socket->disconnectFromServer();
+}
+
+// Clients talk to the daemon through a plain Unix domain socket rather than QLocalSocket,
+// which needs an event dispatcher and hence an application object; see GuiApplication.
+// Returns the connected socket, or -1
+static int connectToDaemon()
+{
+    const QByteArray path = QFile::encodeName(LaunchDaemon::socketPath());
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (size_t(path.size()) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memcpy(address.sun_path, path.constData(), size_t(path.size()));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0) {
+        return fd;
+    }
+    if (errno == EINPROGRESS || errno == EAGAIN) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (poll(&pfd, 1, CONNECT_TIMEOUT_MS) == 1
+            && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+            return fd;
+        }
+    }
+    close(fd);
+    return -1;
+}
+
+// Waits at most timeoutMs for the socket to become ready for events
+static bool waitFor(int fd, short events, int timeoutMs)
+{
+    struct pollfd pfd = { fd, events, 0 };
+    int result;
+    do {
+        result = poll(&pfd, 1, timeoutMs);
+    } while (result == -1 && errno == EINTR);
+    return result == 1;
+}
+
+bool LaunchDaemon::isAvailable()
+{
+    static int available = -1;
+    if (available == -1) {
+        int fd = connectToDaemon();
+        available = fd != -1 ? 1 : 0;
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    return available == 1;
+}
+
+bool LaunchDaemon::resolve(const QStringList &args, QString &bundlePath)
+{
+    if (!isAvailable()) {
+        return false;
+    }
+
+    int fd = connectToDaemon();
+    if (fd == -1) {
+        return false;
+    }
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out << PROTOCOL_VERSION << QString("resolve") << args;
+    int written = 0;
+    while (written < request.size()) {
+        ssize_t length = send(fd, request.constData() + written, size_t(request.size() - written),
+                              MSG_NOSIGNAL);
+        if (length > 0) {
+            written += int(length);
+        } else if (length == -1 && (errno == EAGAIN || errno == EINTR)
+                   && waitFor(fd, POLLOUT, REPLY_TIMEOUT_MS)) {
+            continue;
+        } else {
+            close(fd);
+            return false;
+        }
+    }
+
+    // Read until the complete reply has arrived
+    QByteArray reply;
+    quint32 version = 0;
+    QString path;
+    while (true) {
+        QDataStream in(reply);
+        in >> version >> path;
+        if (in.status() == QDataStream::Ok) {
+            break;
+        }
+        if (!waitFor(fd, POLLIN, REPLY_TIMEOUT_MS)) {
+            qDebug() << "Launch daemon did not answer in time";
+            close(fd);
+            return false;
+        }
+        char buffer[4096];
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            reply.append(buffer, int(length));
+        } else if (length == 0 || (errno != EAGAIN && errno != EINTR)) {
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+
+    if (version != PROTOCOL_VERSION) {
+        return false;
+    }
+    bundlePath = path;
+    return true;
+}
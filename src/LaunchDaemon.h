@@ -0,0 +1,90 @@
+#ifndef LAUNCHDAEMON_H
+#define LAUNCHDAEMON_H
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+class ApplicationWatcher;
+class Launcher;
+
+/**
+ * @file LaunchDaemon.h
+ * @class LaunchDaemon
+ * @brief A long-lived process that keeps the launch database warm and answers
+ * resolution requests over a Unix domain socket.
+ *
+ * The daemon is optional and is started with 'launch --daemon'. It watches the
+ * application locations and applies changes to the launch database as they happen.
+ * While it is running, 'launch', 'open' and 'xdg-open' do not need to discover
+ * applications or clean up the launch database themselves, and looking up an
+ * application bundle by name is answered by the daemon.
+ * If the daemon is not running, everything is done in-process as before.
+ */
+class LaunchDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param parent The parent object.
+     */
+    explicit LaunchDaemon(QObject *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    ~LaunchDaemon();
+
+    /**
+     * @return The path of the Unix domain socket the daemon listens on.
+     */
+    static QString socketPath();
+
+    /**
+     * Discover applications and start listening for requests.
+     *
+     * @return False if the socket could not be created, e.g., because another
+     * daemon is already running.
+     */
+    bool listen();
+
+    /**
+     * Check whether a daemon is running. The result is cached for the lifetime
+     * of the calling process.
+     *
+     * @return True if a daemon accepted a connection.
+     */
+    static bool isAvailable();
+
+    /**
+     * Ask the running daemon to look up an application bundle in the launch database.
+     *
+     * @param args The arguments passed to 'launch'; the first one is the name of the
+     * application to be looked up.
+     * @param bundlePath Receives the path of the application bundle, or an empty string
+     * if the daemon does not know an application by this name. In that case, the daemon
+     * looks for newly installed applications after answering.
+     * @return False if no daemon is running or it did not answer in time.
+     */
+    static bool resolve(const QStringList &args, QString &bundlePath);
+
+private slots:
+    void refresh();
+    void handleConnection();
+
+private:
+    void handleRequest(QLocalSocket *socket);
+
+    QLocalServer *server;
+    QTimer *refreshTimer;
+    Launcher *launcher;
+    ApplicationWatcher *watcher;
+    bool rediscoveryScheduled;
+};
+
+#endif // LAUNCHDAEMON_H
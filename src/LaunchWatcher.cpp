@@ -0,0 +1,163 @@
+#include "LaunchWatcher.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSet>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+static int childSignalPipe[2] = { -1, -1 };
+
+static void handleChildSignal(int)
+{
+    int savedErrno = errno;
+    char c = 0;
+    if (write(childSignalPipe[1], &c, 1) == -1) {
+        // The pipe is full, so the watcher will wake up anyway
+    }
+    errno = savedErrno;
+}
+
+// Returns true if a window in _NET_CLIENT_LIST that has not been seen before
+// belongs to pid
+static bool hasWindowOfPid(Display *display, Atom clientListAtom, Atom pidAtom, pid_t pid,
+                           QSet<Window> &seenWindows)
+{
+    Atom type;
+    int format;
+    unsigned long count, bytesAfter;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display, DefaultRootWindow(display), clientListAtom, 0, 65536, False,
+                           XA_WINDOW, &type, &format, &count, &bytesAfter, &data)
+                != Success
+        || !data) {
+        return false;
+    }
+
+    bool found = false;
+    Window *windows = reinterpret_cast<Window *>(data);
+    for (unsigned long i = 0; i < count && !found; i++) {
+        if (seenWindows.contains(windows[i])) {
+            continue;
+        }
+        seenWindows.insert(windows[i]);
+
+        unsigned char *pidData = nullptr;
+        unsigned long pidCount;
+        if (XGetWindowProperty(display, windows[i], pidAtom, 0, 1, False, XA_CARDINAL, &type,
+                               &format, &pidCount, &bytesAfter, &pidData)
+                    == Success
+            && pidData) {
+            if (pidCount == 1 && pid_t(*reinterpret_cast<unsigned long *>(pidData)) == pid) {
+                qDebug() << "# Window" << windows[i] << "belongs to" << pid;
+                found = true;
+            }
+            XFree(pidData);
+        }
+    }
+    XFree(data);
+    return found;
+}
+
+LaunchWatcher::Result LaunchWatcher::watch(ProcessSpawner &process, int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Wake up when any child exits
+    struct sigaction action = {};
+    struct sigaction previousAction = {};
+    bool haveSignalPipe = pipe(childSignalPipe) == 0;
+    if (haveSignalPipe) {
+        for (int fd : childSignalPipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        action.sa_handler = handleChildSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        sigaction(SIGCHLD, &action, &previousAction);
+    }
+
+    // Wake up when the list of top-level windows changes
+    Display *display = XOpenDisplay(nullptr);
+    Atom clientListAtom = None;
+    Atom pidAtom = None;
+    QSet<Window> seenWindows;
+    if (display) {
+        clientListAtom = XInternAtom(display, "_NET_CLIENT_LIST", False);
+        pidAtom = XInternAtom(display, "_NET_WM_PID", False);
+        XSelectInput(display, DefaultRootWindow(display), PropertyChangeMask);
+        XFlush(display);
+    } else {
+        qDebug() << "# Cannot open X display; only watching for the process to exit";
+    }
+
+    Result result = TimedOut;
+    // Checked once before waiting, in case the window has been mapped already
+    bool clientListChanged = display != nullptr;
+    while (true) {
+        if (!process.isRunning()) {
+            result = Exited;
+            break;
+        }
+        if (clientListChanged
+            && hasWindowOfPid(display, clientListAtom, pidAtom, process.pid(), seenWindows)) {
+            result = WindowMapped;
+            break;
+        }
+        clientListChanged = false;
+
+        qint64 remaining = msecs - timer.elapsed();
+        if (remaining <= 0) {
+            break;
+        }
+
+        // Events may already have been read into the Xlib queue
+        if (!display || XPending(display) == 0) {
+            struct pollfd fds[2];
+            int nfds = 0;
+            if (haveSignalPipe) {
+                fds[nfds++] = { childSignalPipe[0], POLLIN, 0 };
+            }
+            if (display) {
+                fds[nfds++] = { ConnectionNumber(display), POLLIN, 0 };
+            }
+            // Without the signal pipe, fall back to checking for the exit periodically
+            int timeout = haveSignalPipe ? int(remaining) : qMin(int(remaining), 100);
+            poll(fds, nfds, timeout);
+        }
+
+        if (haveSignalPipe) {
+            char buffer[64];
+            while (read(childSignalPipe[0], buffer, sizeof(buffer)) > 0) { }
+        }
+        while (display && XPending(display) > 0) {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == PropertyNotify && event.xproperty.atom == clientListAtom) {
+                clientListChanged = true;
+            }
+        }
+    }
+
+    if (display) {
+        XCloseDisplay(display);
+    }
+    if (haveSignalPipe) {
+        sigaction(SIGCHLD, &previousAction, nullptr);
+        close(childSignalPipe[0]);
+        close(childSignalPipe[1]);
+        childSignalPipe[0] = childSignalPipe[1] = -1;
+    }
+
+    qDebug() << "# Watched the application for" << timer.elapsed() << "milliseconds";
+    return result;
+}
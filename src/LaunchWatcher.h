@@ -0,0 +1,39 @@
+#ifndef LAUNCHWATCHER_H
+#define LAUNCHWATCHER_H
+
+#include "ProcessSpawner.h"
+
+/**
+ * @file LaunchWatcher.h
+ * @class LaunchWatcher
+ * @brief Waits until a launched application has either failed or started successfully.
+ *
+ * Errors like missing libraries or interpreters make an application exit right after
+ * it has been started. Rather than waiting for a fixed amount of time, the watcher
+ * sleeps until something happens: the application exits (SIGCHLD), or a window whose
+ * _NET_WM_PID is the process ID of the application appears in the _NET_CLIENT_LIST
+ * of the root window, in which case the application is considered to have started
+ * successfully. Only if neither happens does the watcher give up after the timeout.
+ *
+ * The X server is talked to directly with Xlib so that no QGuiApplication is needed.
+ */
+class LaunchWatcher
+{
+public:
+    enum Result {
+        Exited, /**< The application has exited. */
+        WindowMapped, /**< The application has mapped a window. */
+        TimedOut /**< Neither has happened before the timeout. */
+    };
+
+    /**
+     * Watch a spawned application.
+     *
+     * @param process The application, which must have been started.
+     * @param msecs The maximum time to wait in milliseconds.
+     * @return What has happened first.
+     */
+    static Result watch(ProcessSpawner &process, int msecs);
+};
+
+#endif // LAUNCHWATCHER_H
@@ -0,0 +1,112 @@
+#include "MenuNotifier.h"
+
+#include <QDebug>
+#include <QVector>
+
+#include <dbus/dbus.h>
+#include <string.h>
+
+static const char MENU_SERVICE[] = "local.Menu";
+
+// Menu answers immediately if it is running; there is no point in waiting any longer
+static const int MENU_CALL_TIMEOUT_MS = 500;
+
+static QVector<DBusPendingCall *> pendingCalls;
+static bool menuUnavailable = false;
+
+static DBusConnection *sessionBus()
+{
+    static bool tried = false;
+    static DBusConnection *connection = nullptr;
+    if (!tried) {
+        tried = true;
+        DBusError error;
+        dbus_error_init(&error);
+        connection = dbus_bus_get(DBUS_BUS_SESSION, &error);
+        if (!connection) {
+            qDebug() << "Cannot connect to the session bus:" << error.message;
+            dbus_error_free(&error);
+        } else {
+            // The connection is shared with libraries that may use it, too
+            dbus_connection_set_exit_on_disconnect(connection, FALSE);
+        }
+    }
+    return connection;
+}
+
+// A call that has failed because nobody owns the service name means that Menu is not
+// running, so later calls need not be sent. Releases the call
+static void finishCall(DBusPendingCall *pendingCall)
+{
+    DBusMessage *reply = dbus_pending_call_steal_reply(pendingCall);
+    if (reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+        const char *name = dbus_message_get_error_name(reply);
+        if (name
+            && (strcmp(name, DBUS_ERROR_SERVICE_UNKNOWN) == 0
+                || strcmp(name, DBUS_ERROR_NAME_HAS_NO_OWNER) == 0)) {
+            menuUnavailable = true;
+        }
+        qDebug() << "D-Bus call to Menu failed:" << name;
+    }
+    if (reply) {
+        dbus_message_unref(reply);
+    }
+    dbus_pending_call_unref(pendingCall);
+}
+
+void MenuNotifier::call(const char *method, const QStringList &arguments)
+{
+    for (int i = pendingCalls.size() - 1; i >= 0; i--) {
+        if (dbus_pending_call_get_completed(pendingCalls.at(i))) {
+            finishCall(pendingCalls.takeAt(i));
+        }
+    }
+    DBusConnection *connection = sessionBus();
+    if (menuUnavailable || !connection) {
+        return;
+    }
+
+    // A plain method call does not introspect the service first
+    DBusMessage *message = dbus_message_new_method_call(MENU_SERVICE, "/", nullptr, method);
+    if (!message) {
+        return;
+    }
+    QVector<QByteArray> utf8Arguments;
+    for (const QString &argument : arguments) {
+        utf8Arguments.append(argument.toUtf8());
+    }
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(message, &iter);
+    for (const QByteArray &argument : qAsConst(utf8Arguments)) {
+        const char *value = argument.constData();
+        dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &value);
+    }
+    DBusPendingCall *pendingCall = nullptr;
+    if (dbus_connection_send_with_reply(connection, message, &pendingCall,
+                                        MENU_CALL_TIMEOUT_MS)
+        && pendingCall) {
+        pendingCalls.append(pendingCall);
+    }
+    dbus_message_unref(message);
+    // Without a main loop, nothing else writes the message to the bus
+    dbus_connection_flush(connection);
+}
+
+void MenuNotifier::showApplicationName(const QString &name)
+{
+    call("showApplicationName", { name });
+}
+
+void MenuNotifier::hideApplicationName()
+{
+    call("hideApplicationName", {});
+}
+
+void MenuNotifier::waitForReplies()
+{
+    for (DBusPendingCall *pendingCall : qAsConst(pendingCalls)) {
+        dbus_pending_call_block(pendingCall);
+        finishCall(pendingCall);
+    }
+    pendingCalls.clear();
+}
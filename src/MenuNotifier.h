@@ -0,0 +1,45 @@
+#ifndef MENUNOTIFIER_H
+#define MENUNOTIFIER_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * @file MenuNotifier.h
+ * @class MenuNotifier
+ * @brief Tells the global menu bar (the local.Menu D-Bus service) about applications
+ * being launched, without waiting for it.
+ *
+ * The calls are sent asynchronously with a short timeout; launching an application
+ * never waits for Menu to answer, even if it is slow or not running. Whether the session
+ * bus can be connected to is checked once per process, and once Menu has been found
+ * not to be running, no further calls are sent to it.
+ *
+ * libdbus is used directly because QtDBus needs an application object, which the
+ * process does not have unless it shows widgets; see GuiApplication.
+ */
+class MenuNotifier
+{
+public:
+    /**
+     * Ask Menu to show the name of the application that is being launched.
+     */
+    static void showApplicationName(const QString &name);
+
+    /**
+     * Ask Menu to stop showing the name, e.g., because the application has failed.
+     */
+    static void hideApplicationName();
+
+    /**
+     * Wait until the calls sent so far have been answered or have timed out, so that
+     * they are not lost when the process exits. Called once the application has been
+     * launched, when waiting does not delay it anymore.
+     */
+    static void waitForReplies();
+
+private:
+    static void call(const char *method, const QStringList &arguments);
+};
+
+#endif // MENUNOTIFIER_H
@@ -0,0 +1,336 @@
+#include "MimeSniffer.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMimeDatabase>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTextStream>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const quint32 GLOBS_MAGIC = 0x4c4d4753; // "LMGS"
+static const quint32 GLOBS_VERSION = 1;
+
+// Enough for all signatures checked in mimeTypeForData()
+static const int HEADER_SIZE = 64;
+
+static QDataStream &operator<<(QDataStream &out, const MimeSniffer::Glob &glob)
+{
+    out << glob.mimeType << glob.pattern << qint32(glob.weight) << glob.caseSensitive;
+    return out;
+}
+
+static QDataStream &operator>>(QDataStream &in, MimeSniffer::Glob &glob)
+{
+    qint32 weight;
+    in >> glob.mimeType >> glob.pattern >> weight >> glob.caseSensitive;
+    glob.weight = weight;
+    return in;
+}
+
+MimeSniffer::MimeSniffer()
+{
+    // In order of decreasing priority, e.g., ~/.local/share/mime/globs2 first
+    sources = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, "mime/globs2");
+
+    QVector<qint64> sourceMtimes;
+    for (const QString &source : qAsConst(sources)) {
+        struct stat st;
+        if (stat(QFile::encodeName(source).constData(), &st) == 0) {
+            sourceMtimes.append(qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec);
+        } else {
+            sourceMtimes.append(0);
+        }
+    }
+
+    if (loadCache(defaultCachePath(), sourceMtimes)) {
+        return;
+    }
+
+    QSet<QString> typesWithoutGlobs;
+    for (const QString &source : qAsConst(sources)) {
+        parseGlobs2(source, typesWithoutGlobs);
+    }
+    qDebug() << "Parsed" << literals.size() + extensions.size() + otherGlobs.size()
+             << "glob patterns from" << sources;
+    saveCache(defaultCachePath(), sourceMtimes);
+}
+
+MimeSniffer &MimeSniffer::instance()
+{
+    static MimeSniffer sniffer;
+    return sniffer;
+}
+
+QString MimeSniffer::defaultCachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/mime-globs";
+}
+
+bool MimeSniffer::loadCache(const QString &cachePath, const QVector<qint64> &sourceMtimes)
+{
+    QFile f(cachePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QStringList cachedSources;
+    QVector<qint64> cachedSourceMtimes;
+    in >> magic >> version;
+    if (magic != GLOBS_MAGIC || version != GLOBS_VERSION) {
+        return false;
+    }
+    in >> cachedSources >> cachedSourceMtimes;
+    if (cachedSources != sources || cachedSourceMtimes != sourceMtimes) {
+        qDebug() << "shared-mime-info has changed since" << cachePath << "was written";
+        return false;
+    }
+    in >> literals >> extensions >> otherGlobs;
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring corrupt glob cache at" << cachePath;
+        literals.clear();
+        extensions.clear();
+        otherGlobs.clear();
+        return false;
+    }
+    return true;
+}
+
+void MimeSniffer::saveCache(const QString &cachePath, const QVector<qint64> &sourceMtimes) const
+{
+    QDir().mkpath(QFileInfo(cachePath).path());
+    QSaveFile f(cachePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write glob cache to" << cachePath;
+        return;
+    }
+    QDataStream out(&f);
+    out << GLOBS_MAGIC << GLOBS_VERSION << sources << sourceMtimes << literals << extensions
+        << otherGlobs;
+    if (!f.commit()) {
+        qDebug() << "Cannot write glob cache to" << cachePath;
+    }
+}
+
+// Lines look like "weight:type:glob[:flags]". Types for which a file with higher
+// priority contains __NOGLOBS__ get no globs from files with lower priority
+void MimeSniffer::parseGlobs2(const QString &globs2Path, QSet<QString> &typesWithoutGlobs)
+{
+    QFile f(globs2Path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    QSet<QString> typesWithoutGlobsHere;
+    QTextStream in(&f);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        const QStringList fields = line.split(':');
+        if (fields.size() < 3) {
+            continue;
+        }
+        Glob glob;
+        glob.weight = fields.at(0).toInt();
+        glob.mimeType = fields.at(1);
+        glob.pattern = fields.at(2);
+        glob.caseSensitive = fields.size() > 3 && fields.at(3).split(',').contains("cs");
+        if (glob.pattern == "__NOGLOBS__") {
+            typesWithoutGlobsHere.insert(glob.mimeType);
+            continue;
+        }
+        if (typesWithoutGlobs.contains(glob.mimeType)) {
+            continue;
+        }
+        addGlob(glob);
+    }
+    typesWithoutGlobs.unite(typesWithoutGlobsHere);
+}
+
+static bool isLiteral(const QString &pattern)
+{
+    return !pattern.contains('*') && !pattern.contains('?') && !pattern.contains('[');
+}
+
+void MimeSniffer::addGlob(const Glob &glob)
+{
+    if (isLiteral(glob.pattern)) {
+        literals[glob.pattern.toLower()].append(glob);
+    } else if (glob.pattern.startsWith("*.") && isLiteral(glob.pattern.mid(2))) {
+        extensions[glob.pattern.mid(2).toLower()].append(glob);
+    } else {
+        otherGlobs.append(glob);
+    }
+}
+
+// Keep the matches with the highest weight; the result is only clear if all of
+// them belong to the same MIME type
+static QString unambiguous(const QVector<MimeSniffer::Glob> &matches)
+{
+    int highestWeight = -1;
+    for (const MimeSniffer::Glob &glob : matches) {
+        highestWeight = qMax(highestWeight, glob.weight);
+    }
+    QString mimeType;
+    for (const MimeSniffer::Glob &glob : matches) {
+        if (glob.weight != highestWeight) {
+            continue;
+        }
+        if (!mimeType.isEmpty() && mimeType != glob.mimeType) {
+            return QString();
+        }
+        mimeType = glob.mimeType;
+    }
+    return mimeType;
+}
+
+// Globs that are case-sensitive only match if the case is the same, e.g., "*.C"
+static QVector<MimeSniffer::Glob> caseMatches(const QVector<MimeSniffer::Glob> &globs,
+                                              const QString &text, bool isExtension)
+{
+    QVector<MimeSniffer::Glob> matches;
+    for (const MimeSniffer::Glob &glob : globs) {
+        if (glob.caseSensitive
+            && (isExtension ? glob.pattern.mid(2) : glob.pattern) != text) {
+            continue;
+        }
+        matches.append(glob);
+    }
+    return matches;
+}
+
+QString MimeSniffer::match(const QString &fileName) const
+{
+    // Literal names, e.g., "Makefile"
+    auto literal = literals.constFind(fileName.toLower());
+    if (literal != literals.constEnd()) {
+        const QVector<Glob> matches = caseMatches(*literal, fileName, false);
+        if (!matches.isEmpty()) {
+            return unambiguous(matches);
+        }
+    }
+
+    // The longest extension wins, e.g., "*.tar.gz" over "*.gz"
+    for (int dot = fileName.indexOf('.'); dot != -1; dot = fileName.indexOf('.', dot + 1)) {
+        const QString extension = fileName.mid(dot + 1);
+        auto it = extensions.constFind(extension.toLower());
+        if (it == extensions.constEnd()) {
+            continue;
+        }
+        const QVector<Glob> matches = caseMatches(*it, extension, true);
+        if (!matches.isEmpty()) {
+            return unambiguous(matches);
+        }
+    }
+
+    // All other patterns, e.g., "*.so.[0-9]*"; the longest one wins
+    QVector<Glob> matches;
+    const QByteArray name = QFile::encodeName(fileName);
+    const QByteArray lowerName = QFile::encodeName(fileName.toLower());
+    int longest = 0;
+    for (const Glob &glob : otherGlobs) {
+        const QByteArray pattern = QFile::encodeName(glob.caseSensitive ? glob.pattern
+                                                                        : glob.pattern.toLower());
+        if (fnmatch(pattern.constData(),
+                    glob.caseSensitive ? name.constData() : lowerName.constData(), 0)
+            != 0) {
+            continue;
+        }
+        if (glob.pattern.size() > longest) {
+            matches.clear();
+            longest = glob.pattern.size();
+        }
+        if (glob.pattern.size() == longest) {
+            matches.append(glob);
+        }
+    }
+    if (!matches.isEmpty()) {
+        return unambiguous(matches);
+    }
+    return QString();
+}
+
+QString MimeSniffer::mimeTypeForFileName(const QString &fileName)
+{
+    return instance().match(fileName);
+}
+
+// Only signatures that identify a MIME type unambiguously
+QString MimeSniffer::mimeTypeForData(const QByteArray &data)
+{
+    if (data.isEmpty()) {
+        return "application/x-zerosize";
+    }
+    if (data.startsWith("%PDF-")) {
+        return "application/pdf";
+    }
+    if (data.startsWith("\x89PNG\r\n\x1a\n")) {
+        return "image/png";
+    }
+    if (data.startsWith("\xff\xd8\xff")) {
+        return "image/jpeg";
+    }
+    if (data.startsWith("GIF87a") || data.startsWith("GIF89a")) {
+        return "image/gif";
+    }
+    // An AppImage of type 2 is an ELF file with "AI\x02" at offset 8
+    if (data.startsWith("\x7f" "ELF") && data.mid(8, 3) == QByteArray("AI\x02", 3)) {
+        return "application/vnd.appimage";
+    }
+    // ELF files of type ET_EXEC; position-independent executables and shared
+    // libraries are both ET_DYN and cannot be told apart by the header alone
+    if (data.startsWith("\x7f" "ELF") && data.size() >= 18) {
+        bool bigEndian = data.at(5) == 2;
+        int type = bigEndian ? (uchar(data.at(16)) << 8) | uchar(data.at(17))
+                             : (uchar(data.at(17)) << 8) | uchar(data.at(16));
+        if (type == 2) {
+            return "application/x-executable";
+        }
+    }
+    return QString();
+}
+
+QString MimeSniffer::mimeTypeForFile(const QString &path)
+{
+    QFileInfo info(path);
+    if (info.isDir()) {
+        return "inode/directory";
+    }
+
+    QString mimeType = mimeTypeForFileName(info.fileName());
+    if (!mimeType.isEmpty()) {
+        return mimeType;
+    }
+
+    // Only read the first bytes, and only once
+    if (info.isFile()) {
+        int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            QByteArray data(HEADER_SIZE, Qt::Uninitialized);
+            ssize_t length = pread(fd, data.data(), data.size(), 0);
+            close(fd);
+            if (length >= 0) {
+                data.truncate(int(length));
+                mimeType = mimeTypeForData(data);
+                if (!mimeType.isEmpty()) {
+                    return mimeType;
+                }
+            }
+        }
+    }
+
+    qDebug() << "Asking QMimeDatabase for the MIME type of" << path;
+    return QMimeDatabase().mimeTypeForFile(path).name();
+}
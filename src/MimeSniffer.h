@@ -0,0 +1,83 @@
+#ifndef MIMESNIFFER_H
+#define MIMESNIFFER_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @file MimeSniffer.h
+ * @class MimeSniffer
+ * @brief Determines the MIME type of a file without QMimeDatabase in the common cases.
+ *
+ * QMimeDatabase loads the complete shared-mime-info database, including all magic
+ * rules, the first time it is used in a process, which costs more than everything
+ * else 'open' does for most documents. Most files, however, are identified by their
+ * name alone.
+ *
+ * MimeSniffer keeps the glob patterns of shared-mime-info (the globs2 files generated
+ * by update-mime-database) in a binary cache in ~/.cache/launch/mime-globs, which is
+ * regenerated whenever one of the globs2 files changes. A file is matched against the
+ * patterns following the rules of the shared-mime-info specification: literal names
+ * first, then the longest matching extension, then other patterns, keeping only the
+ * matches with the highest weight. If no pattern matches, the first bytes of the file
+ * are checked for a few unambiguous signatures, e.g., ELF executables and PDF documents.
+ *
+ * Whenever the answer is not clear, e.g., because patterns of different MIME types
+ * match or the contents of the file would have to be examined in more detail,
+ * QMimeDatabase is asked instead.
+ */
+class MimeSniffer
+{
+public:
+    /**
+     * @param path The path of the file.
+     * @return The name of the MIME type of the file, e.g., "text/plain".
+     */
+    static QString mimeTypeForFile(const QString &path);
+
+    /**
+     * Match a file name against the glob patterns only.
+     *
+     * @param fileName The name of the file without directory.
+     * @return The name of the MIME type, or an empty string if no pattern or patterns
+     * of more than one MIME type match.
+     */
+    static QString mimeTypeForFileName(const QString &fileName);
+
+    /**
+     * @return The location of the binary cache, ~/.cache/launch/mime-globs
+     */
+    static QString defaultCachePath();
+
+    /**
+     * A glob pattern and the MIME type it belongs to.
+     */
+    struct Glob
+    {
+        QString mimeType;
+        QString pattern;
+        int weight = 50;
+        bool caseSensitive = false;
+    };
+
+private:
+    MimeSniffer();
+    static MimeSniffer &instance();
+
+    bool loadCache(const QString &cachePath, const QVector<qint64> &sourceMtimes);
+    void saveCache(const QString &cachePath, const QVector<qint64> &sourceMtimes) const;
+    void parseGlobs2(const QString &globs2Path, QSet<QString> &typesWithoutGlobs);
+    void addGlob(const Glob &glob);
+    QString match(const QString &fileName) const;
+    static QString mimeTypeForData(const QByteArray &data);
+
+    QStringList sources;
+    QHash<QString, QVector<Glob>> literals; /**< Keyed by the lowercase name. */
+    QHash<QString, QVector<Glob>> extensions; /**< Keyed by the lowercase extension. */
+    QVector<Glob> otherGlobs;
+};
+
+#endif // MIMESNIFFER_H
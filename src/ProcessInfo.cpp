@@ -0,0 +1,176 @@
+#include "ProcessInfo.h"
+
+#include <QFile>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__FreeBSD__)
+#  include <sys/param.h>
+#  include <sys/queue.h>
+#  include <sys/socket.h>
+#  include <sys/sysctl.h>
+#  include <sys/user.h>
+#  include <libprocstat.h>
+#endif
+
+bool ProcessInfo::userId(pid_t pid, uid_t &uid)
+{
+    if (pid <= 0) {
+        return false;
+    }
+#if defined(__FreeBSD__)
+    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PID, int(pid) };
+    struct kinfo_proc info;
+    size_t size = sizeof(info);
+    if (sysctl(mib, 4, &info, &size, nullptr, 0) != 0 || size != sizeof(info)) {
+        return false;
+    }
+    uid = info.ki_uid;
+    return true;
+#else
+    // /proc/<pid> belongs to the effective user ID of the process
+    struct stat st;
+    if (stat(QFile::encodeName(QString("/proc/%1").arg(pid)).constData(), &st) != 0) {
+        return false;
+    }
+    uid = st.st_uid;
+    return true;
+#endif
+}
+
+bool ProcessInfo::isOwnedByCurrentUser(pid_t pid)
+{
+    uid_t uid;
+    return userId(pid, uid) && uid == getuid();
+}
+
+QString ProcessInfo::executable(pid_t pid)
+{
+    if (pid <= 0) {
+        return QString();
+    }
+#if defined(__FreeBSD__)
+    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PATHNAME, int(pid) };
+    char path[PATH_MAX];
+    size_t size = sizeof(path);
+    if (sysctl(mib, 4, path, &size, nullptr, 0) != 0 || size == 0) {
+        return QString();
+    }
+    return QFile::decodeName(path);
+#else
+    return QFile::symLinkTarget(QString("/proc/%1/exe").arg(pid));
+#endif
+}
+
+QStringList ProcessInfo::environment(pid_t pid)
+{
+    QStringList entries;
+    if (pid <= 0) {
+        return entries;
+    }
+#if defined(__FreeBSD__)
+    struct procstat *prstat = procstat_open_sysctl();
+    if (prstat == nullptr) {
+        return entries;
+    }
+    unsigned int count;
+    struct kinfo_proc *info = procstat_getprocs(prstat, KERN_PROC_PID, pid, &count);
+    if (info != nullptr && count == 1) {
+        char **envs = procstat_getenvv(prstat, info, 0);
+        for (int i = 0; envs != nullptr && envs[i] != nullptr; i++) {
+            entries.append(QString::fromLocal8Bit(envs[i]));
+        }
+        procstat_freeenvv(prstat);
+    }
+    if (info != nullptr) {
+        procstat_freeprocs(prstat, info);
+    }
+    procstat_close(prstat);
+#else
+    // Files in /proc report a size of 0, so read until the end
+    QFile environFile(QString("/proc/%1/environ").arg(pid));
+    if (!environFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return entries;
+    }
+    const QList<QByteArray> variables = environFile.readAll().split('\0');
+    for (const QByteArray &variable : variables) {
+        if (!variable.isEmpty()) {
+            entries.append(QString::fromLocal8Bit(variable));
+        }
+    }
+#endif
+    return entries;
+}
+
+QString ProcessInfo::environmentValue(pid_t pid, const char *name)
+{
+    if (pid <= 0) {
+        return QString();
+    }
+    const size_t nameLength = strlen(name);
+#if defined(__FreeBSD__)
+    QString value;
+    struct procstat *prstat = procstat_open_sysctl();
+    if (prstat == nullptr) {
+        return value;
+    }
+    unsigned int count;
+    struct kinfo_proc *info = procstat_getprocs(prstat, KERN_PROC_PID, pid, &count);
+    if (info != nullptr && count == 1) {
+        char **envs = procstat_getenvv(prstat, info, 0);
+        for (int i = 0; envs != nullptr && envs[i] != nullptr; i++) {
+            if (strncmp(envs[i], name, nameLength) == 0 && envs[i][nameLength] == '=') {
+                value = QString::fromLocal8Bit(envs[i] + nameLength + 1);
+                break;
+            }
+        }
+        procstat_freeenvv(prstat);
+    }
+    if (info != nullptr) {
+        procstat_freeprocs(prstat, info);
+    }
+    procstat_close(prstat);
+    return value;
+#else
+    // Read /proc/<pid>/environ in large chunks and scan the NUL-separated entries in
+    // place; files in /proc report a size of 0, so read until the end
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/environ", int(pid));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return QString();
+    }
+    QByteArray environment(32 * 1024, Qt::Uninitialized);
+    int size = 0;
+    while (true) {
+        if (size == environment.size()) {
+            environment.resize(environment.size() * 2);
+        }
+        ssize_t length = read(fd, environment.data() + size, size_t(environment.size() - size));
+        if (length <= 0) {
+            break;
+        }
+        size += int(length);
+    }
+    close(fd);
+
+    const char *p = environment.constData();
+    const char *end = p + size;
+    while (p < end) {
+        const char *entryEnd = static_cast<const char *>(memchr(p, '\0', size_t(end - p)));
+        if (!entryEnd) {
+            entryEnd = end;
+        }
+        if (size_t(entryEnd - p) > nameLength && memcmp(p, name, nameLength) == 0
+            && p[nameLength] == '=') {
+            return QString::fromLocal8Bit(p + nameLength + 1,
+                                          int(entryEnd - p - nameLength - 1));
+        }
+        p = entryEnd + 1;
+    }
+    return QString();
+#endif
+}
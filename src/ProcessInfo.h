@@ -0,0 +1,59 @@
+#ifndef PROCESSINFO_H
+#define PROCESSINFO_H
+
+#include <QString>
+#include <QStringList>
+
+#include <sys/types.h>
+
+/**
+ * @file ProcessInfo.h
+ * @class ProcessInfo
+ * @brief Information about running processes, obtained without running other programs.
+ *
+ * On Linux, the information is read from /proc/<pid>; on FreeBSD, it is obtained
+ * with sysctl and libprocstat.
+ */
+class ProcessInfo
+{
+public:
+    /**
+     * @param pid The process ID.
+     * @param uid Receives the user ID the process is running under.
+     * @return False if the process does not exist or cannot be inspected.
+     */
+    static bool userId(pid_t pid, uid_t &uid);
+
+    /**
+     * @param pid The process ID.
+     * @return True if the process exists and runs under the user ID of this process.
+     */
+    static bool isOwnedByCurrentUser(pid_t pid);
+
+    /**
+     * @param pid The process ID.
+     * @return The path of the executable of the process, or an empty string if it
+     * cannot be determined, e.g., because the process belongs to another user.
+     */
+    static QString executable(pid_t pid);
+
+    /**
+     * @param pid The process ID.
+     * @return The environment the process was started with as "NAME=value" entries,
+     * or an empty list if it cannot be read.
+     */
+    static QStringList environment(pid_t pid);
+
+    /**
+     * Look up a single variable in the environment of a process without splitting
+     * the whole environment into entries.
+     *
+     * @param pid The process ID.
+     * @param name The name of the variable, e.g., "LAUNCHED_BUNDLE".
+     * @return The value of the variable, or an empty string if it is not set or the
+     * environment cannot be read.
+     */
+    static QString environmentValue(pid_t pid, const char *name);
+};
+
+#endif // PROCESSINFO_H
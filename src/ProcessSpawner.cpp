@@ -0,0 +1,232 @@
+#include "ProcessSpawner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const qint64 MAX_STANDARD_ERROR_SIZE = 64 * 1024;
+
+// Applications keep writing to their standard error file for as long as they run,
+// so files that have grown larger than this are emptied
+static const qint64 MAX_STANDARD_ERROR_FILE_SIZE = 1024 * 1024;
+static const int WAIT_POLL_INTERVAL_MS = 10;
+
+ProcessSpawner::ProcessSpawner() : m_pid(0), m_finished(false), m_status(0), m_stderrFd(-1) { }
+
+ProcessSpawner::~ProcessSpawner()
+{
+    detach();
+}
+
+void ProcessSpawner::setProgram(const QString &program)
+{
+    m_program = program;
+}
+
+QString ProcessSpawner::program() const
+{
+    return m_program;
+}
+
+void ProcessSpawner::setArguments(const QStringList &arguments)
+{
+    m_arguments = arguments;
+}
+
+void ProcessSpawner::setEnvironment(const QStringList &environment)
+{
+    m_environment = environment;
+}
+
+QString ProcessSpawner::standardErrorDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/stderr";
+}
+
+// Remove the standard error files of applications that are not running anymore, and
+// empty those of running applications that have grown too large. The files are opened
+// for appending, so the applications continue writing at the start of the emptied file
+void ProcessSpawner::cleanUpStandardErrorFiles()
+{
+    const QFileInfoList files =
+            QDir(standardErrorDirectory()).entryInfoList({ "*.log" }, QDir::Files);
+    for (const QFileInfo &file : files) {
+        bool ok = false;
+        pid_t pid = pid_t(file.fileName().section('.', 0, 0).toLongLong(&ok));
+        if (ok && pid > 0 && kill(pid, 0) == -1 && errno == ESRCH) {
+            QFile::remove(file.filePath());
+        } else if (file.size() > MAX_STANDARD_ERROR_FILE_SIZE) {
+            truncate(QFile::encodeName(file.filePath()).constData(), 0);
+        }
+    }
+}
+
+bool ProcessSpawner::start()
+{
+    cleanUpStandardErrorFiles();
+    QDir().mkpath(standardErrorDirectory());
+
+    // The file is renamed after the process ID once it is known
+    QByteArray stderrTemplate = QFile::encodeName(standardErrorDirectory() + "/spawn-XXXXXX");
+    m_stderrFd = mkstemp(stderrTemplate.data());
+    if (m_stderrFd == -1) {
+        qDebug() << "Cannot create standard error file:" << strerror(errno);
+    } else {
+        fcntl(m_stderrFd, F_SETFD, FD_CLOEXEC);
+        fcntl(m_stderrFd, F_SETFL, O_APPEND);
+    }
+
+    QVector<QByteArray> argumentData;
+    argumentData.append(QFile::encodeName(m_program));
+    for (const QString &argument : qAsConst(m_arguments)) {
+        argumentData.append(argument.toLocal8Bit());
+    }
+    QVector<char *> argv;
+    for (QByteArray &argument : argumentData) {
+        argv.append(argument.data());
+    }
+    argv.append(nullptr);
+
+    QVector<QByteArray> environmentData;
+    for (const QString &variable : qAsConst(m_environment)) {
+        environmentData.append(variable.toLocal8Bit());
+    }
+    QVector<char *> envp;
+    for (QByteArray &variable : environmentData) {
+        envp.append(variable.data());
+    }
+    envp.append(nullptr);
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    if (m_stderrFd != -1) {
+        posix_spawn_file_actions_adddup2(&fileActions, m_stderrFd, STDERR_FILENO);
+    }
+
+    // Do not pass on signal dispositions and the signal mask of this process
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    sigaddset(&defaultSignals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    int error = posix_spawnp(&m_pid, argv.first(), &fileActions, &attributes, argv.data(),
+                             envp.data());
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&fileActions);
+
+    if (error != 0) {
+        qDebug() << "Cannot spawn" << m_program << ":" << strerror(error);
+        m_pid = 0;
+        if (m_stderrFd != -1) {
+            close(m_stderrFd);
+            m_stderrFd = -1;
+            unlink(stderrTemplate.constData());
+        }
+        return false;
+    }
+
+    if (m_stderrFd != -1) {
+        QByteArray stderrPath =
+                QFile::encodeName(standardErrorDirectory() + "/" + QString::number(m_pid) + ".log");
+        rename(stderrTemplate.constData(), stderrPath.constData());
+        qDebug() << "Standard error of" << m_pid << "goes to" << stderrPath;
+    }
+    return true;
+}
+
+pid_t ProcessSpawner::pid() const
+{
+    return m_pid;
+}
+
+bool ProcessSpawner::isRunning()
+{
+    if (m_pid <= 0 || m_finished) {
+        return false;
+    }
+    int status = 0;
+    pid_t result = waitpid(m_pid, &status, WNOHANG);
+    if (result == m_pid) {
+        m_finished = true;
+        m_status = status;
+        return false;
+    }
+    if (result == -1 && errno == ECHILD) {
+        m_finished = true;
+        return false;
+    }
+    return true;
+}
+
+bool ProcessSpawner::waitForFinished(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (isRunning()) {
+        if (timer.elapsed() >= msecs) {
+            return false;
+        }
+        QThread::msleep(WAIT_POLL_INTERVAL_MS);
+    }
+    return m_pid > 0;
+}
+
+int ProcessSpawner::exitCode() const
+{
+    if (!m_finished || !WIFEXITED(m_status)) {
+        return -1;
+    }
+    return WEXITSTATUS(m_status);
+}
+
+int ProcessSpawner::exitSignal() const
+{
+    if (!m_finished || !WIFSIGNALED(m_status)) {
+        return 0;
+    }
+    return WTERMSIG(m_status);
+}
+
+QString ProcessSpawner::readAllStandardError() const
+{
+    if (m_stderrFd == -1) {
+        return QString();
+    }
+    QByteArray data(int(MAX_STANDARD_ERROR_SIZE), Qt::Uninitialized);
+    ssize_t length = pread(m_stderrFd, data.data(), data.size(), 0);
+    if (length <= 0) {
+        return QString();
+    }
+    data.truncate(int(length));
+    return QString::fromLocal8Bit(data);
+}
+
+void ProcessSpawner::detach()
+{
+    if (m_stderrFd != -1) {
+        close(m_stderrFd);
+        m_stderrFd = -1;
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef PROCESSSPAWNER_H
+#define PROCESSSPAWNER_H
+
+#include <QString>
+#include <QStringList>
+
+#include <sys/types.h>
+
+/**
+ * @file ProcessSpawner.h
+ * @class ProcessSpawner
+ * @brief Starts an application with posix_spawn and lets it run on its own.
+ *
+ * Unlike QProcess, the application is started without duplicating the address space
+ * of this process, and this process does not need to stay around for as long as the
+ * application runs: once it is clear that the application has started successfully,
+ * the spawner detaches and the application is reparented to init, which reaps it.
+ *
+ * The standard error of the application is written to a file in
+ * ~/.cache/launch/stderr/ that is named after its process ID, rather than to a pipe.
+ * A pipe would have to be read for as long as the application runs, and writing to
+ * it after this process has exited would kill the application with SIGPIPE
+ * (https://github.com/helloSystem/launch/issues/4). Files of applications that are
+ * not running anymore are removed the next time an application is spawned, and files
+ * that have grown too large are emptied, see cleanUpStandardErrorFiles().
+ */
+class ProcessSpawner
+{
+public:
+    /**
+     * Constructor.
+     */
+    ProcessSpawner();
+
+    /**
+     * Destructor. Detaches from the application if it is still running.
+     */
+    ~ProcessSpawner();
+
+    void setProgram(const QString &program);
+    QString program() const;
+    void setArguments(const QStringList &arguments);
+
+    /**
+     * @param environment The environment of the application as "NAME=value" strings.
+     */
+    void setEnvironment(const QStringList &environment);
+
+    /**
+     * Start the application. Standard input and output are inherited.
+     *
+     * @return False if the application could not be executed, e.g., because the file
+     * is not an executable.
+     */
+    bool start();
+
+    /**
+     * @return The process ID of the application, or 0 if it has not been started.
+     */
+    pid_t pid() const;
+
+    /**
+     * Wait for the application to exit.
+     *
+     * @param msecs The maximum time to wait in milliseconds.
+     * @return True if the application has exited.
+     */
+    bool waitForFinished(int msecs);
+
+    /**
+     * @return True if the application has been started and has not exited yet.
+     */
+    bool isRunning();
+
+    /**
+     * @return The exit code of the application, or -1 if it was killed by a signal
+     * or has not exited yet.
+     */
+    int exitCode() const;
+
+    /**
+     * @return The signal that killed the application, or 0 if it exited normally
+     * or has not exited yet.
+     */
+    int exitSignal() const;
+
+    /**
+     * @return What the application has written to standard error so far,
+     * up to 64 KiB.
+     */
+    QString readAllStandardError() const;
+
+    /**
+     * Stop watching the application. It keeps running and is reaped by init once
+     * this process has exited.
+     */
+    void detach();
+
+    /**
+     * Remove the standard error files of applications that are not running anymore,
+     * and empty those of running applications that have grown larger than 1 MiB.
+     * The standard error of a running application cannot be redirected from outside,
+     * so this is what keeps the files of long-running applications from growing
+     * without bound.
+     */
+    static void cleanUpStandardErrorFiles();
+
+private:
+    static QString standardErrorDirectory();
+
+    QString m_program;
+    QStringList m_arguments;
+    QStringList m_environment;
+    pid_t m_pid;
+    bool m_finished;
+    int m_status;
+    int m_stderrFd;
+};
+
+#endif // PROCESSSPAWNER_H
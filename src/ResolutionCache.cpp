@@ -0,0 +1,270 @@
+#include "ResolutionCache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DbManager.h"
+#include "DirectoryFingerprints.h"
+
+static const quint32 RESOLUTIONS_MAGIC = 0x4c524553; // "LRES"
+static const quint32 RESOLUTIONS_VERSION = 2;
+
+static QDataStream &operator<<(QDataStream &out, const Resolution &resolution)
+{
+    out << resolution.executable << resolution.executableDevice << resolution.executableInode
+        << resolution.executableMtimeNs << resolution.executableCtimeNs << resolution.bundle
+        << resolution.bundleDevice << resolution.bundleInode << resolution.bundleMtimeNs
+        << resolution.path << resolution.pathStamps << resolution.applicationsMtimeNs;
+    return out;
+}
+
+static QDataStream &operator>>(QDataStream &in, Resolution &resolution)
+{
+    in >> resolution.executable >> resolution.executableDevice >> resolution.executableInode
+            >> resolution.executableMtimeNs >> resolution.executableCtimeNs >> resolution.bundle
+            >> resolution.bundleDevice >> resolution.bundleInode >> resolution.bundleMtimeNs
+            >> resolution.path >> resolution.pathStamps >> resolution.applicationsMtimeNs;
+    return in;
+}
+
+ResolutionCache::ResolutionCache(const QString &storePath)
+    : storePath(storePath), hitCount(0), missCount(0), loadedHitCount(0), loadedMissCount(0)
+{
+    load();
+}
+
+ResolutionCache::~ResolutionCache() { }
+
+QString ResolutionCache::defaultStorePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/launch/resolution-cache";
+}
+
+bool ResolutionCache::stamp(const QString &path, quint64 &device, quint64 &inode,
+                            qint64 &mtimeNs, qint64 *ctimeNs)
+{
+    struct stat st;
+    if (stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return false;
+    }
+    device = st.st_dev;
+    inode = st.st_ino;
+    mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    if (ctimeNs) {
+        *ctimeNs = qint64(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+    }
+    return true;
+}
+
+// Installing or removing an executable in a directory of the $PATH changes the
+// modification time of that directory; directories that do not exist are recorded
+// as zeros, so that creating them is noticed as well
+QVector<qint64> ResolutionCache::pathStamps(const QString &path)
+{
+    QVector<qint64> stamps;
+    const QStringList directories = path.split(':');
+    stamps.reserve(directories.size() * 3);
+    for (const QString &directory : directories) {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 mtimeNs = 0;
+        stamp(directory.isEmpty() ? QString(".") : directory, device, inode, mtimeNs);
+        stamps << qint64(device) << qint64(inode) << mtimeNs;
+    }
+    return stamps;
+}
+
+// Applications are added to and removed from the launch database by changing the
+// symlinks in this directory, which changes its modification time
+qint64 ResolutionCache::applicationsMtimeNs()
+{
+    DirectoryFingerprint fingerprint;
+    if (!DirectoryFingerprints::currentFingerprint(DbManager::localShareLaunchApplicationsPath,
+                                                   fingerprint)) {
+        return 0;
+    }
+    return fingerprint.mtimeNs;
+}
+
+bool ResolutionCache::lookUp(const QString &name, QString &executable)
+{
+    auto it = resolutions.constFind(name);
+    bool valid = it != resolutions.constEnd();
+
+    if (valid) {
+        quint64 device, inode;
+        qint64 mtimeNs, ctimeNs;
+        valid = it->path == QString::fromLocal8Bit(qgetenv("PATH"))
+                && it->applicationsMtimeNs == applicationsMtimeNs()
+                && stamp(it->executable, device, inode, mtimeNs, &ctimeNs)
+                && device == it->executableDevice && inode == it->executableInode
+                && mtimeNs == it->executableMtimeNs && ctimeNs == it->executableCtimeNs
+                && access(QFile::encodeName(it->executable).constData(), X_OK) == 0
+                && pathStamps(it->path) == it->pathStamps;
+        if (valid && !it->bundle.isEmpty()) {
+            valid = stamp(it->bundle, device, inode, mtimeNs) && device == it->bundleDevice
+                    && inode == it->bundleInode && mtimeNs == it->bundleMtimeNs;
+        }
+        if (!valid) {
+            qDebug() << "Cached resolution of" << name << "is stale";
+            resolutions.remove(name);
+            changedNames.insert(name);
+        }
+    }
+
+    if (valid) {
+        hitCount++;
+        executable = it->executable;
+        qDebug() << "Resolved" << name << "to" << executable << "from the resolution cache";
+    } else {
+        missCount++;
+    }
+    return valid;
+}
+
+void ResolutionCache::insert(const QString &name, const QString &executable,
+                             const QString &bundle)
+{
+    Resolution resolution;
+    resolution.executable = executable;
+    if (!stamp(executable, resolution.executableDevice, resolution.executableInode,
+               resolution.executableMtimeNs, &resolution.executableCtimeNs)) {
+        return;
+    }
+    if (!bundle.isEmpty()) {
+        resolution.bundle = bundle;
+        if (!stamp(bundle, resolution.bundleDevice, resolution.bundleInode,
+                   resolution.bundleMtimeNs)) {
+            return;
+        }
+    }
+    resolution.path = QString::fromLocal8Bit(qgetenv("PATH"));
+    resolution.pathStamps = pathStamps(resolution.path);
+    resolution.applicationsMtimeNs = applicationsMtimeNs();
+    resolutions.insert(name, resolution);
+    changedNames.insert(name);
+}
+
+void ResolutionCache::remove(const QString &name)
+{
+    resolutions.remove(name);
+    changedNames.insert(name);
+}
+
+quint64 ResolutionCache::hits() const
+{
+    return hitCount;
+}
+
+quint64 ResolutionCache::misses() const
+{
+    return missCount;
+}
+
+int ResolutionCache::count() const
+{
+    return resolutions.size();
+}
+
+bool ResolutionCache::load()
+{
+    if (!read(hitCount, missCount, resolutions)) {
+        return false;
+    }
+    loadedHitCount = hitCount;
+    loadedMissCount = missCount;
+    return true;
+}
+
+bool ResolutionCache::read(quint64 &hits, quint64 &misses,
+                           QHash<QString, Resolution> &entries) const
+{
+    QFile f(storePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != RESOLUTIONS_MAGIC || version != RESOLUTIONS_VERSION) {
+        qDebug() << "Ignoring resolution cache in unknown format at" << storePath;
+        return false;
+    }
+    in >> hits >> misses >> entries;
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring corrupt resolution cache at" << storePath;
+        entries.clear();
+        hits = 0;
+        misses = 0;
+        return false;
+    }
+    return true;
+}
+
+bool ResolutionCache::save()
+{
+    QDir().mkpath(QFileInfo(storePath).path());
+
+    // Serialise saving with other processes; the lock is released when the descriptor
+    // is closed
+    const int lockFd = open(QFile::encodeName(storePath + ".lock").constData(),
+                            O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd != -1) {
+        while (flock(lockFd, LOCK_EX) == -1 && errno == EINTR) { }
+    }
+
+    // Apply the changes of this process to what other processes have saved since
+    quint64 savedHits = 0;
+    quint64 savedMisses = 0;
+    QHash<QString, Resolution> saved;
+    read(savedHits, savedMisses, saved);
+    for (const QString &name : qAsConst(changedNames)) {
+        auto it = resolutions.constFind(name);
+        if (it == resolutions.constEnd()) {
+            saved.remove(name);
+        } else {
+            saved.insert(name, *it);
+        }
+    }
+    const quint64 hits = savedHits + (hitCount - loadedHitCount);
+    const quint64 misses = savedMisses + (missCount - loadedMissCount);
+
+    bool success = false;
+    QSaveFile f(storePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write resolution cache to" << storePath;
+    } else {
+        QDataStream out(&f);
+        out << RESOLUTIONS_MAGIC << RESOLUTIONS_VERSION << hits << misses << saved;
+        success = f.commit();
+        if (!success) {
+            qDebug() << "Cannot write resolution cache to" << storePath;
+        }
+    }
+    if (lockFd != -1) {
+        close(lockFd);
+    }
+    if (!success) {
+        return false;
+    }
+
+    resolutions = saved;
+    changedNames.clear();
+    hitCount = loadedHitCount = hits;
+    missCount = loadedMissCount = misses;
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef RESOLUTIONCACHE_H
+#define RESOLUTIONCACHE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+/**
+ * @file ResolutionCache.h
+ * @brief A persisted cache of what 'launch <name>' has resolved names to.
+ */
+
+/**
+ * What a name was resolved to, and the state of the files involved at that time.
+ */
+struct Resolution
+{
+    QString executable; /**< The executable that was launched. */
+    quint64 executableDevice = 0;
+    quint64 executableInode = 0;
+    qint64 executableMtimeNs = 0;
+    qint64 executableCtimeNs = 0; /**< Changes with the permissions, e.g., 'chmod -x'. */
+    QString bundle; /**< The bundle the executable was found in, if any. */
+    quint64 bundleDevice = 0;
+    quint64 bundleInode = 0;
+    qint64 bundleMtimeNs = 0;
+    QString path; /**< The $PATH at the time of resolution. */
+    QVector<qint64> pathStamps; /**< Device, inode and mtime of each $PATH directory. */
+    qint64 applicationsMtimeNs = 0; /**< Modification time of the launch database. */
+};
+
+/**
+ * @class ResolutionCache
+ * @brief Remembers which executable a bare application name was resolved to.
+ *
+ * Resolving a name like "FeatherPad" means checking the current directory, searching
+ * the $PATH and matching the name against all applications in the launch database.
+ * The result is cached together with the device, inode and modification time of the
+ * executable and its bundle, the $PATH and the device, inode and modification time of
+ * each of its directories, and the modification time of the launch database. If any of
+ * these has changed, e.g., because an executable by that name has been installed in
+ * a directory of the $PATH, or the executable is not executable anymore, the cached
+ * result is not used.
+ *
+ * The numbers of hits and misses are persisted as well and can be shown with
+ * 'launch --resolution-cache-stats'.
+ */
+class ResolutionCache
+{
+public:
+    /**
+     * Constructor. Loads the cache from disk if it exists.
+     *
+     * @param storePath The path of the file in which the cache is persisted.
+     */
+    explicit ResolutionCache(const QString &storePath = defaultStorePath());
+
+    /**
+     * Destructor.
+     */
+    ~ResolutionCache();
+
+    /**
+     * @return The default location of the cache, ~/.cache/launch/resolution-cache
+     */
+    static QString defaultStorePath();
+
+    /**
+     * Look up a name and check whether the cached result is still valid.
+     * Counts a hit or a miss.
+     *
+     * @param name The name as given to 'launch'.
+     * @param executable Receives the executable if the name is in the cache.
+     * @return True on a hit.
+     */
+    bool lookUp(const QString &name, QString &executable);
+
+    /**
+     * Record what a name has been resolved to.
+     *
+     * @param name The name as given to 'launch'.
+     * @param executable The executable that is launched.
+     * @param bundle The bundle the executable was found in, or an empty string.
+     */
+    void insert(const QString &name, const QString &executable, const QString &bundle);
+
+    /**
+     * Forget what a name has been resolved to, e.g., because launching it failed.
+     */
+    void remove(const QString &name);
+
+    quint64 hits() const;
+    quint64 misses() const;
+    int count() const;
+
+    /**
+     * Write the cache and the counters to disk.
+     *
+     * Other processes may have saved the cache since it was loaded, so the file is read
+     * again under a lock and only the changes made by this process are applied to it:
+     * the hits and misses counted since loading are added, and the names that have been
+     * inserted or removed are updated.
+     *
+     * @return True on success.
+     */
+    bool save();
+
+private:
+    bool load();
+    bool read(quint64 &hits, quint64 &misses, QHash<QString, Resolution> &entries) const;
+    static bool stamp(const QString &path, quint64 &device, quint64 &inode, qint64 &mtimeNs,
+                      qint64 *ctimeNs = nullptr);
+    static QVector<qint64> pathStamps(const QString &path);
+    static qint64 applicationsMtimeNs();
+
+    QString storePath;
+    QHash<QString, Resolution> resolutions;
+    QSet<QString> changedNames; /**< Names inserted or removed since loading. */
+    quint64 hitCount;
+    quint64 missCount;
+    quint64 loadedHitCount;
+    quint64 loadedMissCount;
+};
+
+#endif // RESOLUTIONCACHE_H
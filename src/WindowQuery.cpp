@@ -0,0 +1,103 @@
+#include "WindowQuery.h"
+
+#include <QDebug>
+
+#include <xcb/xcb.h>
+
+#include <stdlib.h>
+
+WindowQuery::WindowQuery()
+    : connection(xcb_connect(nullptr, nullptr)), root(XCB_NONE), clientListAtom(XCB_NONE),
+      pidAtom(XCB_NONE)
+{
+    if (xcb_connection_has_error(connection)) {
+        qDebug() << "# Cannot connect to the X server";
+        return;
+    }
+    root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+
+    // Both requests are sent before waiting for either reply
+    xcb_intern_atom_cookie_t clientListCookie =
+            xcb_intern_atom(connection, true, 16, "_NET_CLIENT_LIST");
+    xcb_intern_atom_cookie_t pidCookie = xcb_intern_atom(connection, true, 11, "_NET_WM_PID");
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, clientListCookie, nullptr);
+    if (reply) {
+        clientListAtom = reply->atom;
+        free(reply);
+    }
+    reply = xcb_intern_atom_reply(connection, pidCookie, nullptr);
+    if (reply) {
+        pidAtom = reply->atom;
+        free(reply);
+    }
+}
+
+WindowQuery::~WindowQuery()
+{
+    xcb_disconnect(connection);
+}
+
+bool WindowQuery::isConnected() const
+{
+    return !xcb_connection_has_error(connection) && clientListAtom != XCB_NONE;
+}
+
+QVector<WindowQuery::ClientWindow> WindowQuery::clientWindows() const
+{
+    QVector<ClientWindow> windows;
+    if (!isConnected()) {
+        return windows;
+    }
+
+    xcb_get_property_reply_t *listReply = xcb_get_property_reply(
+            connection,
+            xcb_get_property(connection, false, root, clientListAtom, XCB_ATOM_WINDOW, 0, 65536),
+            nullptr);
+    if (!listReply) {
+        return windows;
+    }
+    const int count = xcb_get_property_value_length(listReply) / int(sizeof(xcb_window_t));
+    const xcb_window_t *ids = static_cast<xcb_window_t *>(xcb_get_property_value(listReply));
+
+    // Send all requests first, then collect the replies, so that they are pipelined
+    QVector<xcb_get_property_cookie_t> cookies;
+    cookies.reserve(count);
+    for (int i = 0; i < count; i++) {
+        cookies.append(xcb_get_property(connection, false, ids[i], pidAtom, XCB_ATOM_CARDINAL,
+                                        0, 1));
+    }
+    windows.reserve(count);
+    for (int i = 0; i < count; i++) {
+        ClientWindow window = { ids[i], 0 };
+        xcb_get_property_reply_t *pidReply =
+                xcb_get_property_reply(connection, cookies.at(i), nullptr);
+        if (pidReply) {
+            if (xcb_get_property_value_length(pidReply) == 4) {
+                window.pid = pid_t(*static_cast<quint32 *>(xcb_get_property_value(pidReply)));
+            }
+            free(pidReply);
+        }
+        windows.append(window);
+    }
+    free(listReply);
+    return windows;
+}
+
+pid_t WindowQuery::pid(unsigned long id) const
+{
+    pid_t pid = 0;
+    if (!isConnected()) {
+        return pid;
+    }
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(
+            connection,
+            xcb_get_property(connection, false, id, pidAtom, XCB_ATOM_CARDINAL, 0, 1),
+            nullptr);
+    if (reply) {
+        if (xcb_get_property_value_length(reply) == 4) {
+            pid = pid_t(*static_cast<quint32 *>(xcb_get_property_value(reply)));
+        }
+        free(reply);
+    }
+    return pid;
+}
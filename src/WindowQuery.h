@@ -0,0 +1,67 @@
+#ifndef WINDOWQUERY_H
+#define WINDOWQUERY_H
+
+#include <QVector>
+
+#include <sys/types.h>
+
+struct xcb_connection_t;
+
+/**
+ * @file WindowQuery.h
+ * @class WindowQuery
+ * @brief Finds the top-level windows and the processes they belong to with a single
+ * X server connection.
+ *
+ * The atoms are interned once when the connection is opened, and the _NET_WM_PID
+ * properties of all windows are requested before the first reply is waited for, so
+ * listing the windows costs three round trips regardless of how many windows there
+ * are. The X server is talked to directly with xcb so that no QGuiApplication is needed.
+ */
+class WindowQuery
+{
+public:
+    /**
+     * A top-level window as listed in _NET_CLIENT_LIST.
+     */
+    struct ClientWindow
+    {
+        unsigned long id;
+        pid_t pid; /**< From _NET_WM_PID, or 0 if the window does not have it. */
+    };
+
+    /**
+     * Constructor. Connects to the X server given by $DISPLAY and interns the atoms.
+     */
+    WindowQuery();
+
+    /**
+     * Destructor. Closes the connection.
+     */
+    ~WindowQuery();
+
+    /**
+     * @return True if the X server could be connected to.
+     */
+    bool isConnected() const;
+
+    /**
+     * @return The windows in the _NET_CLIENT_LIST of the root window, in the order
+     * they were mapped, together with their _NET_WM_PID.
+     */
+    QVector<ClientWindow> clientWindows() const;
+
+    /**
+     * @param id A window, which need not be in _NET_CLIENT_LIST.
+     * @return The _NET_WM_PID of the window, or 0 if it does not have one.
+     */
+    pid_t pid(unsigned long id) const;
+
+private:
+    xcb_connection_t *connection;
+    quint32 root;
+    quint32 clientListAtom;
+    quint32 pidAtom;
+};
+
+#endif // WINDOWQUERY_H
@@ -8,7 +8,15 @@
 #  include <sys/xattr.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <QDebug>
+#include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 // #include <QProcess>
 #include <QStandardPaths>
 
@@ -18,42 +26,155 @@ using namespace Fm;
 
 namespace Fm {
 
-static const int ATTR_VAL_SIZE = 20480; // FIXME: Can we do without a predetermined size?
-// ANSWER: Yes, by calling extattr_get_file twice; see
-// https://github.com/probonopd/Filer/blob/da3499361150215f9b5dc6cd3d21165a9025e5f5/src/ExtendedAttributes.cpp#L110-L149
-// TODO: Use that
-//
-// If this size is too small, then reading extattr fails, leading to strange unexpected errors
-// including segfaults of 'launch', preventing the desktop from starting up
-// 256 was not enough to read, e.g., 'can-open' containing many MIME types;
-// 2048 was still not enough to handle, e.g., org.shotcut.Shotcut.desktop
-
 /*
- * get the attibute value from the extended attribute for the path as int
+ * the name of an attribute as passed to the system calls
  */
-int getAttributeValueInt(const QString &path, const QString &attribute, bool &ok)
+static QByteArray attributeName(const QString &attribute)
 {
-    int value = 0;
+#if defined(BSD)
+    return attribute.toLatin1();
+#else
+    return QByteArray(XATTR_NAMESPACE ".") + attribute.toLatin1();
+#endif
+}
 
-    // get the value from the extended attribute for the path
-    char data[ATTR_VAL_SIZE];
+static ssize_t readAttributeRaw(int fd, const char *path, const char *name, void *data, size_t size)
+{
 #if defined(BSD)
-    ssize_t bytesRetrieved = extattr_get_file(path.toLatin1().data(), EXTATTR_NAMESPACE_USER,
-                                              attribute.toLatin1().data(), data, ATTR_VAL_SIZE);
+    if (fd != -1)
+        return extattr_get_fd(fd, EXTATTR_NAMESPACE_USER, name, data, size);
+    return extattr_get_file(path, EXTATTR_NAMESPACE_USER, name, data, size);
 #else
-    QString namespacedAttr;
-    namespacedAttr.append(XATTR_NAMESPACE).append(".").append(attribute);
-    ssize_t bytesRetrieved =
-            getxattr(path.toLatin1().data(), namespacedAttr.toLatin1().data(), data, ATTR_VAL_SIZE);
+    if (fd != -1)
+        return fgetxattr(fd, name, data, size);
+    return getxattr(path, name, data, size);
 #endif
+}
+
+/*
+ * read an attribute of an open file, or of the path if fd is -1; the size of the value
+ * is probed first, so that values of any size can be read without a fixed-size buffer
+ */
+static bool readAttribute(int fd, const char *path, const char *name, QByteArray &value)
+{
+    for (int attempt = 0; attempt < 3; attempt++) {
+        ssize_t size = readAttributeRaw(fd, path, name, nullptr, 0);
+        if (size < 0)
+            return false;
+        value.resize(int(size));
+        if (size == 0)
+            return true;
+        ssize_t bytesRetrieved = readAttributeRaw(fd, path, name, value.data(), size_t(size));
+        if (bytesRetrieved >= 0) {
+            value.truncate(int(bytesRetrieved));
+            return true;
+        }
+        // The value has grown between probing and reading it
+        if (errno != ERANGE)
+            return false;
+    }
+    return false;
+}
+
+/*
+ * convert a value as stored by setAttributeValueQString, including the \0 termination char
+ */
+static QString toQString(const QByteArray &value)
+{
+    int end = value.indexOf('\0');
+    return QString::fromUtf8(value.constData(), end == -1 ? value.size() : end).trimmed();
+}
+
+/*
+ * get the attribute value from the extended attribute of an already open file
+ */
+QByteArray getAttributeValue(int fd, const QString &attribute, bool &ok)
+{
+    QByteArray value;
+    ok = readAttribute(fd, nullptr, attributeName(attribute).constData(), value);
+    return value;
+}
+
+/*
+ * get several attribute values for the path as QString, opening the file only once;
+ * attributes that are not set are not contained in the result
+ */
+QHash<QString, QString> getAttributeValues(const QString &path, const QStringList &attributes)
+{
+    QHash<QString, QString> values;
+    const QByteArray encodedPath = QFile::encodeName(path);
+    // Files that cannot be opened for reading may still have readable attributes,
+    // so fall back to reading them by path
+    int fd = open(encodedPath.constData(), O_RDONLY | O_CLOEXEC);
+    QByteArray value;
+    for (const QString &attribute : attributes) {
+        if (readAttribute(fd, encodedPath.constData(), attributeName(attribute).constData(),
+                          value))
+            values.insert(attribute, toQString(value));
+    }
+    if (fd != -1)
+        close(fd);
+    return values;
+}
+
+// Reads the attributes of every stride-th path on a thread of the pool; each task
+// writes only to its own elements of the results
+class GetAttributeValuesTask : public QRunnable
+{
+public:
+    GetAttributeValuesTask(const QStringList &paths, const QStringList &attributes,
+                           QVector<QHash<QString, QString>> &results, int first, int stride)
+        : paths(paths), attributes(attributes), results(results), first(first), stride(stride)
+    {
+    }
+    void run() override
+    {
+        for (int i = first; i < paths.size(); i += stride)
+            results[i] = getAttributeValues(paths.at(i), attributes);
+    }
+
+private:
+    const QStringList &paths;
+    const QStringList &attributes;
+    QVector<QHash<QString, QString>> &results;
+    int first;
+    int stride;
+};
+
+/*
+ * get several attribute values for many paths concurrently, so that the round trips to
+ * slow disks and network filesystems overlap; the results are in the order of the paths
+ */
+QVector<QHash<QString, QString>> getAttributeValues(const QStringList &paths,
+                                                    const QStringList &attributes)
+{
+    QVector<QHash<QString, QString>> results(paths.size());
+    // Most of the time is spent waiting for the filesystem, so use more threads than
+    // there are cores
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+    const int tasks = qMin(paths.size(), pool.maxThreadCount());
+    for (int first = 0; first < tasks; first++)
+        pool.start(new GetAttributeValuesTask(paths, attributes, results, first, tasks));
+    pool.waitForDone();
+    return results;
+}
+
+/*
+ * get the attibute value from the extended attribute for the path as int
+ */
+int getAttributeValueInt(const QString &path, const QString &attribute, bool &ok)
+{
+    int value = 0;
+    ok = false;
+    QByteArray data;
     // check if we got the attribute value
-    if (bytesRetrieved <= 0)
-        ok = false;
-    else {
+    if (readAttribute(-1, QFile::encodeName(path).constData(),
+                      attributeName(attribute).constData(), data)
+        && !data.isEmpty()) {
         // convert the value to int via QString
-        QString strValue(data);
         bool intOK;
-        int val = strValue.toInt(&intOK);
+        int val = toQString(data).toInt(&intOK);
         if (intOK) {
             ok = true;
             value = val;
@@ -77,31 +198,13 @@ bool setAttributeValueInt(const QString &path, const QString &attribute, int val
  */
 QString getAttributeValueQString(const QString &path, const QString &attribute, bool &ok)
 {
-    // get the value from the extended attribute for the path
-    char data[ATTR_VAL_SIZE];
-#if defined(BSD)
-    ssize_t bytesRetrieved = extattr_get_file(path.toLatin1().data(), EXTATTR_NAMESPACE_USER,
-                                              attribute.toLatin1().data(), data, ATTR_VAL_SIZE);
-#else
-    QString namespacedAttr;
-    namespacedAttr.append(XATTR_NAMESPACE).append(".").append(attribute);
-    ssize_t bytesRetrieved =
-            getxattr(path.toLatin1().data(), namespacedAttr.toLatin1().data(), data, ATTR_VAL_SIZE);
-#endif
-    // check if we got the attribute value
-    if (bytesRetrieved < 0) // If this is 0, then the value is empty but the extattr is set. If this
-                            // is < 0, extattr is not set
-        ok = false;
-    else {
-        // convert the value to QString
-        data[bytesRetrieved] = 0;
-        QString strValue;
-        strValue = QString::fromStdString(data);
-        strValue = strValue.trimmed();
-        ok = true;
-        return strValue;
-    }
-    return nullptr;
+    QByteArray data;
+    // If the value is empty, the extattr is set; if reading fails, it is not set
+    ok = readAttribute(-1, QFile::encodeName(path).constData(),
+                       attributeName(attribute).constData(), data);
+    if (!ok)
+        return nullptr;
+    return toQString(data);
 }
 
 /*
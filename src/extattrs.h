@@ -3,9 +3,17 @@
 #ifndef EXTATTRS_H
 #define EXTATTRS_H
 
+#include <QByteArray>
+#include <QHash>
 #include <QString>
+#include <QStringList>
+#include <QVector>
 
 namespace Fm {
+QByteArray getAttributeValue(int fd, const QString &attribute, bool &ok);
+QHash<QString, QString> getAttributeValues(const QString &path, const QStringList &attributes);
+QVector<QHash<QString, QString>> getAttributeValues(const QStringList &paths,
+                                                    const QStringList &attributes);
 int getAttributeValueInt(const QString &path, const QString &attribute, bool &ok);
 bool setAttributeValueInt(const QString &path, const QString &attribute, int value);
 QString getAttributeValueQString(const QString &path, const QString &attribute, bool &ok);
@@ -1,6 +1,11 @@
-#include <QApplication>
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "GuiApplication.h"
 
 #include "launcher.h"
+#include "LaunchDaemon.h"
+#include "ResolutionCache.h"
 
 /*
  * All documents shall be opened through this tool on helloDesktop
@@ -18,8 +23,8 @@
  * 4. As a fallback, via Baloo? (not implemented yet)
  *
  * launch.db is populated
- * 1. By this tool (currently each time it is invoked; could be optimized to: only if application is
-not found)
+ * 1. By this tool (each time it is invoked, unless the launch daemon is running, in which case
+the daemon keeps it up to date)
  * 2. By the file manager when one looks at applications (can be implemented natively or using
 bundle-thumbnailer)
  *
@@ -32,6 +37,10 @@ in,
  *
  * Usage:
  * launch <application to be launched> [<arguments>]    Launch the specified application
+ * launch --rescan [...]                                Rescan all application locations first
+ * launch --daemon                                      Keep launch.db warm and answer lookups
+ * launch --resolution-cache-stats                      Show how often names were resolved from
+ *                                                      the resolution cache
 
 Similar to https://github.com/probonopd/appwrapper and GNUstep openapp
 
@@ -56,7 +65,42 @@ will also list all paths that are attempted.
 int main(int argc, char *argv[])
 {
 
-    QApplication app(argc, argv);
+    // Keep the launch database warm in a long-lived process so that
+    // the other invocations do not need to discover applications
+    if (argc > 1 && QString(argv[1]) == "--daemon") {
+        QCoreApplication app(argc, argv);
+        LaunchDaemon daemon;
+        if (!daemon.listen()) {
+            return 1;
+        }
+        return app.exec();
+    }
+
+    // No application object is constructed here; the widget stack is only brought up
+    // if a message box or dialog is shown, and launching an application usually does
+    // not need it
+    GuiApplication::setArguments(argc, argv);
+
+    QStringList args;
+    for (int i = 1; i < argc; i++) {
+        args.append(QString::fromLocal8Bit(argv[i]));
+    }
+
+    // Show whether the resolution cache is effective; answered before the Launcher is
+    // constructed, which opens the launch database and may replay journals
+    if (!args.isEmpty() && args.first() == "--resolution-cache-stats") {
+        ResolutionCache cache;
+        quint64 lookups = cache.hits() + cache.misses();
+        QTextStream(stdout) << "Entries: " << cache.count() << "\n"
+                            << "Hits: " << cache.hits() << "\n"
+                            << "Misses: " << cache.misses() << "\n"
+                            << "Hit rate: "
+                            << (lookups ? QString::number(100.0 * cache.hits() / lookups, 'f', 1)
+                                                  + "%"
+                                        : QString("n/a"))
+                            << "\n";
+        return 0;
+    }
 
     Launcher *launcher = new Launcher();
 
@@ -67,27 +111,39 @@ int main(int argc, char *argv[])
     // Launch an application but initially watch for errors and display a Qt error message
     // if needed. After some timeout, detach the process of the application, and exit this helper
 
-    QStringList args = app.arguments();
+    // Ignore the directory fingerprints and scan all well-known locations
+    bool fullRescan = false;
+    if (!args.isEmpty() && args.first() == "--rescan") {
+        args.pop_front();
+        fullRescan = true;
+    }
 
-    args.pop_front();
+    // If the launch daemon is running, it takes care of discovering applications
+    if (fullRescan || !LaunchDaemon::isAvailable()) {
+        launcher->discoverApplications(fullRescan);
+    }
 
-    launcher->discoverApplications();
+    if (fullRescan && args.isEmpty()) {
+        delete launcher;
+        return 0;
+    }
 
+    int result = 1;
     if (QFileInfo(argv[0]).fileName() == "launch") {
         if (args.isEmpty()) {
             qCritical() << "USAGE:" << argv[0] << "<application to be launched> [<arguments>]";
             exit(1);
         }
-        return launcher->launch(args);
-    }
-
-    if (QFileInfo(argv[0]).fileName().endsWith("open")) {
+        result = launcher->launch(args);
+    } else if (QFileInfo(argv[0]).fileName().endsWith("open")) {
         if (args.isEmpty()) {
             qCritical() << "USAGE:" << argv[0] << "<document to be opened>";
             exit(1);
         }
-        return launcher->open(args);
+        result = launcher->open(args);
     }
 
-    return 1;
+    // Commits pending changes, collects garbage if due and writes the index
+    delete launcher;
+    return result;
 }
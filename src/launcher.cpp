@@ -1,18 +1,32 @@
 #include "launcher.h"
 #include "ApplicationSelectionDialog.h"
 #include <unistd.h>
+#include <string.h>
 #include <QApplication>
 #include <NETWM>
-#include <X11/Xlib.h>
-#include <X11/Xatom.h>
 #include "Executable.h"
+#include "GuiApplication.h"
+#include "LaunchDaemon.h"
+#include "LaunchWatcher.h"
+#include "MenuNotifier.h"
+#include "MimeSniffer.h"
+#include "ProcessInfo.h"
+#include "ProcessSpawner.h"
+#include "ResolutionCache.h"
+#include "WindowQuery.h"
 #include <QMessageBox>
 
-Launcher::Launcher() : db(new DbManager()) { }
+// While the launch daemon is running, it keeps launch.db free of dangling symlinks
+Launcher::Launcher() : db(new DbManager(!LaunchDaemon::isAvailable())) { }
 
 Launcher::~Launcher()
 {
-    db->~DbManager();
+    delete db;
+}
+
+DbManager *Launcher::database() const
+{
+    return db;
 }
 
 // If a package needs to be updated, tell the user how to do this,
@@ -42,11 +56,12 @@ QString Launcher::getPackageUpdateCommand(QString pathToInstalledFile)
 
 // Translate cryptic errors into clear text, and possibly even offer buttons to
 // take action
-void Launcher::handleError(QDetachableProcess *p, QString errorString)
+void Launcher::handleError(const QString &program, QString errorString)
 {
+    GuiApplication::ensure();
     QMessageBox qmesg;
 
-    QFileInfo fi(p->program());
+    QFileInfo fi(program);
     QString title = fi.completeBaseName(); // https://doc.qt.io/qt-5/qfileinfo.html#completeBaseName
 
     // Make this error message not appear in the Dock // FIXME: Does not work,
@@ -135,15 +150,20 @@ void Launcher::handleError(QDetachableProcess *p, QString errorString)
     }
 }
 
-// Find apps on well-known paths and put them into launch.db
-void Launcher::discoverApplications()
+// Find apps on well-known paths and put them into launch.db;
+// only directories that have changed since the last run are scanned
+// unless fullRescan is true
+void Launcher::discoverApplications(bool fullRescan)
 {
     // Measure the time it takes to look up candidates
     QElapsedTimer timer;
     timer.start();
     AppDiscovery *ad = new AppDiscovery(db);
+    ad->setFullRescan(fullRescan);
     QStringList wellKnownLocs = ad->wellKnownApplicationLocations();
     ad->findAppsInside(wellKnownLocs);
+    ad->saveFingerprints();
+    db->writeIndex(fullRescan);
     // Print to stdout how long it took to discover applications
     qDebug() << "Took" << timer.elapsed()
              << "milliseconds to discover applications and add them to "
@@ -183,6 +203,7 @@ QStringList Launcher::executableForBundleOrExecutablePath(QString bundleOrExecut
             QStringList execStringAndArgs = QProcess::splitCommand(
                     s); // This should hopefully treat quoted strings halfway correctly
             if (execStringAndArgs.first().count(QLatin1Char('\\')) > 0) {
+                GuiApplication::ensure();
                 QMessageBox::warning(nullptr, " ",
                                      "Launching such complex .desktop files is not supported yet.\n"
                                              + bundleOrExecutablePath);
@@ -193,6 +214,7 @@ QStringList Launcher::executableForBundleOrExecutablePath(QString bundleOrExecut
                 if (! executable.contains("/")) {
                     QString executablePath = QStandardPaths::findExecutable(executable);
                     if (executablePath == "") {
+                        GuiApplication::ensure();
                         QMessageBox::warning(nullptr,
                                              QApplication::tr("Executable not found"),
                                              QApplication::tr("Could not find executable %1 on $PATH.\n%2")
@@ -212,6 +234,7 @@ QStringList Launcher::executableForBundleOrExecutablePath(QString bundleOrExecut
                     executableAndArgs = QStringList({ bundleOrExecutablePath });
                 } else {
                     qDebug() << "# Found non-executable" << bundleOrExecutablePath;
+                    GuiApplication::ensure();
                     bool success = Executable::askUserToMakeExecutable(bundleOrExecutablePath);
                     if (!success) {
                         exit(1);
@@ -228,19 +251,61 @@ QStringList Launcher::executableForBundleOrExecutablePath(QString bundleOrExecut
 QString Launcher::pathWithoutBundleSuffix(QString path)
 {
     // List of common bundle suffixes to remove
-    QStringList bundleSuffixes = { ".AppDir", ".app", ".desktop", ".AppImage", ".appimage" };
+    static const QStringList bundleSuffixes = { ".AppDir", ".app", ".desktop", ".AppImage" };
 
-    QString cleanedPath = path;
     for (const QString &suffix : bundleSuffixes) {
-        cleanedPath = cleanedPath.remove(QRegularExpression(suffix, QRegularExpression::CaseInsensitiveOption));
+        if (path.endsWith(suffix, Qt::CaseInsensitive)) {
+            path.chop(suffix.length());
+            break;
+        }
+    }
+
+    return path;
+}
+
+// Look up an application bundle by name in launch.db
+QString Launcher::bundleForName(const QString &name)
+{
+    // The index knows the applications by name, the preferred one first
+    QStringList candidates;
+    if (db->applicationsForName(name, candidates)) {
+        QStringList removalCandidates;
+        for (const QString &appBundleCandidate : qAsConst(candidates)) {
+            if (QFileInfo::exists(appBundleCandidate)) {
+                qDebug() << "Selected from the index of launch.db:" << appBundleCandidate;
+                db->handleApplications(removalCandidates);
+                return appBundleCandidate;
+            }
+            removalCandidates.append(appBundleCandidate);
+        }
+        db->handleApplications(removalCandidates);
     }
 
-    return cleanedPath;
+    // Names that are not in the index, e.g., partial ones, are matched against
+    // all applications
+    const QStringList allAppsFromDb = db->allApplications();
+
+    for (const QString &appBundleCandidate : allAppsFromDb) {
+        // Now that we may have collected different candidates, decide on which
+        // one to use e.g., the one with the highest self-declared version number.
+        // Also we need to check whether the appBundleCandidate exist
+        // For now, just use the first one
+        if (pathWithoutBundleSuffix(appBundleCandidate).endsWith(name)) {
+            if (QFileInfo(appBundleCandidate).exists()) {
+                qDebug() << "Selected from launch.db:" << appBundleCandidate;
+                return appBundleCandidate;
+            } else {
+                db->handleApplication(appBundleCandidate); // Remove from launch.db it
+                                                           // if it does not exist
+            }
+        }
+    }
+    return QString();
 }
 
 int Launcher::launch(QStringList args)
 {
-    QDetachableProcess p;
+    ProcessSpawner p;
 
     QString executable = nullptr;
     QString firstArg = args.first();
@@ -256,6 +321,13 @@ int Launcher::launch(QStringList args)
 
     args.pop_front();
 
+    // Bare names that have been resolved before do not need to be looked up again,
+    // unless something by that name exists in the current directory
+    ResolutionCache resolutionCache;
+    bool resolutionCacheable = !firstArg.contains("/") && !QFileInfo::exists(firstArg);
+    bool resolutionCacheHit =
+            resolutionCacheable && resolutionCache.lookUp(firstArg, executable);
+
     // First, try to find something we can launch at the path that was supplied as
     // an argument, Examples:
     //    /Applications/LibreOffice.app
@@ -263,7 +335,8 @@ int Launcher::launch(QStringList args)
     //    /Applications/LibreOffice.AppImage
     //    /Applications/libreoffice
 
-    QStringList e = executableForBundleOrExecutablePath(firstArg);
+    QStringList e = resolutionCacheHit ? QStringList()
+                                       : executableForBundleOrExecutablePath(firstArg);
     if (e.length() > 0) {
         executable = e.first();
 
@@ -273,6 +346,7 @@ int Launcher::launch(QStringList args)
             QFileInfo info = QFileInfo(executable);
             if(! info.isExecutable()) {
                 qDebug() << "# Found non-executable" << executable;
+                GuiApplication::ensure();
                 bool success = Executable::askUserToMakeExecutable(executable);
                 if (!success) {
                     exit(1);
@@ -300,32 +374,22 @@ int Launcher::launch(QStringList args)
         QElapsedTimer timer;
         timer.start();
 
-        // Iterate recursively through locationsContainingApps searching for AppRun
-        // files in matchingly named AppDirs
-
-        QFileInfoList candidates;
-
-        QStringList allAppsFromDb = db->allApplications();
-
-        for (QString appBundleCandidate : allAppsFromDb) {
-            // Now that we may have collected different candidates, decide on which
-            // one to use e.g., the one with the highest self-declared version number.
-            // Also we need to check whether the appBundleCandidate exist
-            // For now, just use the first one
-            if (pathWithoutBundleSuffix(appBundleCandidate).endsWith(firstArg)) {
-                if (QFileInfo(appBundleCandidate).exists()) {
-                    qDebug() << "Selected from launch.db:" << appBundleCandidate;
-                    selectedBundle = appBundleCandidate;
-                    break;
-                } else {
-                    db->handleApplication(appBundleCandidate); // Remove from launch.db it
-                                                               // if it does not exist
-                }
-            }
+        // Ask the launch daemon first, if one is running, because it has
+        // launch.db in memory already
+        QStringList argsForDaemon = { firstArg };
+        argsForDaemon.append(args);
+        if (!LaunchDaemon::resolve(argsForDaemon, selectedBundle)) {
+            selectedBundle = bundleForName(firstArg);
+        } else if (selectedBundle.isEmpty()) {
+            // The daemon does not know the application (yet), e.g., because it has been
+            // installed somewhere that is not watched; look for it here
+            discoverApplications();
+            selectedBundle = bundleForName(firstArg);
         }
 
         // For the selectedBundle, get the launchable executable
         if (selectedBundle == "") {
+            GuiApplication::ensure();
             QMessageBox::warning(nullptr, " ",
                                  QString("The application '%1'\ncan't be launched "
                                          "because it can't be found.")
@@ -341,6 +405,10 @@ int Launcher::launch(QStringList args)
         }
     }
 
+    if (resolutionCacheable && !resolutionCacheHit && executable != nullptr) {
+        resolutionCache.insert(firstArg, executable, selectedBundle);
+    }
+
     // .desktop files can have arguments in them, and we need to insert the
     // arguments given to launch on the command line into the arguments coming
     // from the desktop file. So we have to construct arguments from the desktop
@@ -404,11 +472,10 @@ int Launcher::launch(QStringList args)
                                                   // the real location
     }
     // qDebug() << "# env" << env.toStringList();
-    p.setProcessEnvironment(env);
-    qDebug() << "#  p.processEnvironment():" << p.processEnvironment().toStringList();
+    p.setEnvironment(env.toStringList());
+    qDebug() << "#  environment:" << env.toStringList();
 
-    p.setProcessChannelMode(
-            QProcess::ForwardedOutputChannel); // Forward stdout onto the main process
+    // Standard output is inherited, standard error is captured
     qDebug() << "# program:" << p.program();
     qDebug() << "# args:" << args;
 
@@ -426,38 +493,28 @@ int Launcher::launch(QStringList args)
     // box with D-Bus
     if (args.length() < 1 && env.contains("LAUNCHED_BUNDLE") && (firstArg != "Menu")) {
         qDebug() << "# Checking for existing windows";
-        const auto &windows = KWindowSystem::windows();
+        const WindowQuery windowQuery;
+        const QVector<WindowQuery::ClientWindow> windows = windowQuery.clientWindows();
         bool foundExistingWindow = false;
-        for (WId wid : windows) {
+        for (const WindowQuery::ClientWindow &window : windows) {
+            const WId wid = window.id;
+            const int pid = window.pid;
+            if (pid == 0) {
+                continue;
+            }
 
-            QString runningBundle = ApplicationInfo::bundlePathForWId(wid);
+            QString runningBundle = ApplicationInfo::bundlePathForPId(pid);
             if (runningBundle == env.value("LAUNCHED_BUNDLE")) {
                 // Check if the user ID which the application is running under is the same user ID as is the current user
                 // This is to avoid bringing to the front windows of other users (e.g., if we want to run as root)
-                // FIXME: Find a way that works on all platforms and takes ~3 lines of code instead of ~20
-                int pid = 0;
-                Display *display = XOpenDisplay(nullptr);
-                Atom type;
-                int format;
-                unsigned long nitems, bytes_after;
-                unsigned char *prop;
-                int status = XGetWindowProperty(display, wid, XInternAtom(display, "_NET_WM_PID", False), 0, 1, False, XA_CARDINAL, &type, &format, &nitems, &bytes_after, &prop);
-                if (status == Success && prop) {
-                    pid = *(unsigned long *)prop;
-                    XFree(prop);
-                }
-                XCloseDisplay(display);
                 qDebug() << "# _NET_WM_PID:" << pid;
-                QProcess process;
-                process.start("ps", QStringList() << "-p" << QString::number(pid) << "-o" << "user");
-                process.waitForFinished(-1);
-                QString processOutput = process.readAllStandardOutput();
-                if (processOutput.split("\n").at(1) != qgetenv("USER")) {
+                if (!ProcessInfo::isOwnedByCurrentUser(pid)) {
                     qDebug() << "# Not activating window" << wid << "because it is running under a different user ID";
                     continue;
                 }
             
                 foundExistingWindow = true;
+                GuiApplication::ensure();
                 KWindowSystem::forceActiveWindow(wid);
             }
         }
@@ -482,14 +539,21 @@ int Launcher::launch(QStringList args)
         qDebug() << "# Not checking for existing windows";
     }
 
-    // Start new process
-    p.start();
+    // Start new process; this fails if the file cannot be executed
+    bool started = p.start();
 
     // Tell Menu that an application is being launched
     QString bPath = ApplicationInfo::bundlePath(p.program());
 
-    // Blocks until process has started
-    if (!p.waitForStarted()) {
+    // Also persists the hit and miss counters
+    if (resolutionCacheable) {
+        if (!started) {
+            resolutionCache.remove(firstArg);
+        }
+        resolutionCache.save();
+    }
+
+    if (!started) {
         // The reason we ended up here may well be that the file has executable permissions despite
         // it not being an executable file, hence we can't launch it. So we try to open it with its
         // default application
@@ -508,55 +572,43 @@ int Launcher::launch(QStringList args)
             stringToBeDisplayed = desktopFile.value("Desktop Entry/Name").toString();
         }
 
-        if (QDBusConnection::sessionBus().isConnected()) {
-            QDBusInterface iface("local.Menu", "/", "", QDBusConnection::sessionBus());
-            if (!iface.isValid()) {
-                qDebug() << "D-Bus interface not valid";
-            } else {
-                QDBusReply<QString> reply = iface.call("showApplicationName", stringToBeDisplayed);
-                if (!reply.isValid()) {
-                    qDebug() << "D-Bus reply not valid";
-                } else {
-                    qDebug() << QString("D-Bus reply: %1\n").arg(reply.value());
-                }
-            }
-        }
+        MenuNotifier::showApplicationName(stringToBeDisplayed);
     }
 
-    p.waitForFinished(10
-                      * 1000); // Blocks until process has finished or timeout occured (x seconds)
-    // Errors occuring thereafter will not be reported to the user in a message
-    // box anymore. This should cover most errors like missing libraries, missing
-    // interpreters, etc.
+    // Blocks until the process has exited, has mapped a window, or the timeout has
+    // occured (x seconds). Errors occuring thereafter will not be reported to the user
+    // in a message box anymore. This should cover most errors like missing libraries,
+    // missing interpreters, etc.
+    LaunchWatcher::Result watchResult = LaunchWatcher::watch(p, 10 * 1000);
+    qDebug() << "# Watch result:" << watchResult;
 
-    if (p.state() == 0 and p.exitCode() != 0) {
+    if (watchResult == LaunchWatcher::Exited && p.exitCode() != 0) {
         qDebug("Process is not running anymore and exit code was not 0");
         QString error = p.readAllStandardError();
-        if (error.isEmpty()) {
+        if (error.isEmpty() && p.exitSignal() != 0) {
+            error = QString("%1 exited unexpectedly\nbecause of signal %2 (%3)")
+                            .arg(nameWithoutSuffix)
+                            .arg(p.exitSignal())
+                            .arg(QString::fromLocal8Bit(strsignal(p.exitSignal())));
+        } else if (error.isEmpty()) {
             error = QString("%1 exited unexpectedly\nwith exit code %2")
                             .arg(nameWithoutSuffix)
                             .arg(p.exitCode());
         }
 
         qDebug() << error;
-        handleError(&p, error);
 
         // Tell Menu that an application is no more being launched
-        if (QDBusConnection::sessionBus().isConnected()) {
-            QDBusInterface iface("local.Menu", "/", "", QDBusConnection::sessionBus());
-            if (!iface.isValid()) {
-                qDebug() << "D-Bus interface not valid";
-            } else {
-                QDBusReply<QString> reply = iface.call("hideApplicationName");
-                if (!reply.isValid()) {
-                    qDebug() << "D-Bus reply not valid";
-                } else {
-                    qDebug() << QString("D-Bus reply: %1\n").arg(reply.value());
-                }
-            }
-        }
+        MenuNotifier::hideApplicationName();
+        MenuNotifier::waitForReplies();
+
+        // Only now bring up the GUI, after the process and the D-Bus connection
+        // are not needed anymore
+        handleError(p.program(), error);
 
-        exit(p.exitCode());
+        db->collectGarbageIfDue();
+        // Like shells do, report a signal as 128 plus its number
+        exit(p.exitSignal() != 0 ? 128 + p.exitSignal() : p.exitCode());
     }
 
     // When we have made it all the way to here, add our application to the
@@ -567,23 +619,17 @@ int Launcher::launch(QStringList args)
         db->handleApplication(env.value("LAUNCHED_BUNDLE"));
     }
 
-    db->~DbManager();
-
-    p.waitForFinished(-1);
+    db->writeIndex();
 
-    // Is this a way to p.detach(); and return(0)
-    // without crashing the payload application
-    // when it writes to stderr?
-    // https://github.com/helloSystem/launch/issues/4
-    // TODO: Make these picked up by a crash reporter; maybe name them with the
-    // pid? p.setStandardErrorFile("/tmp/launch_error");
-    // p.setStandardOutputFile("/tmp/launch_output");
-    // p.setInputChannelMode(QProcess::ManagedInputChannel); // "Unforward"
+    // Do not wait for the application to exit; it keeps running on its own
+    // and is reaped by init once we have exited
+    p.detach();
+    MenuNotifier::waitForReplies();
 
-    // NOTE: 'daemon launch ...' will lead to '<defunct>' in 'ps ax' output
-    // after the following runs; does this have any negative impact other than
-    // cosmetics?
-    // p.detach();
+    // Now that the application is running, the user does not have to wait for this;
+    // the process may leave through exit() without destroying the DbManager
+    db->collectGarbageIfDue();
+    db->writeIndex();
     return (0);
 }
 
@@ -629,6 +675,7 @@ int Launcher::open(QStringList args)
         if (QFileInfo(firstArg).isSymLink()) {
             // Broken symlink
             // TODO: Offer to delete or fix broken symlinks
+            GuiApplication::ensure();
             QMessageBox::warning(nullptr, " ",
                                  QString("The symlink '%1'\ncan't be opened "
                                          "because\nthe target '%2'\ncan't be found.")
@@ -636,10 +683,12 @@ int Launcher::open(QStringList args)
                                          .arg(QFileInfo(firstArg).symLinkTarget()));
         } else {
             // File not found
+            GuiApplication::ensure();
             QMessageBox::warning(
                     nullptr, " ",
                     QString("'%1'\ncan't be opened because it can't be found.").arg(firstArg));
         }
+        db->collectGarbageIfDue();
         exit(1);
     }
 
@@ -652,6 +701,7 @@ int Launcher::open(QStringList args)
             exit(launch(args));
         } else {
             qDebug() << "# Found non-executable" << firstArg;
+            GuiApplication::ensure();
             bool success = Executable::askUserToMakeExecutable(firstArg);
             if (!success) {
                 exit(1);
@@ -680,7 +730,7 @@ int Launcher::open(QStringList args)
     QString mimeType;
     if (appToBeLaunched.isNull()) {
         // Get MIME type of file to be opened
-        mimeType = QMimeDatabase().mimeTypeForFile(firstArg).name();
+        mimeType = MimeSniffer::mimeTypeForFile(firstArg);
 
         // Handle legacy XDG style "file:///..." URIs
         // by converting them to sane "/...". Example: Falkon downloads being
@@ -727,6 +777,7 @@ int Launcher::open(QStringList args)
         QStringList blacklistedMimeTypes = { "application/octet-stream" };
         for (const QString blacklistedMimeType : blacklistedMimeTypes) {
             if ((mimeType == blacklistedMimeType) && (!firstArg.contains(":/"))) {
+                GuiApplication::ensure();
                 QMessageBox::warning(
                         nullptr, " ",
                         QString("Cannot open %1\nof MIME type '%2'.").arg(firstArg, mimeType));
@@ -746,7 +797,7 @@ int Launcher::open(QStringList args)
         if (!showChooserRequested) {
             QString mimePath = QString("%1/%2")
                                        .arg(db->localShareLaunchMimePath)
-                                       .arg(mimeType.replace("/", "_"));
+                                       .arg(QString(mimeType).replace("/", "_"));
             QString defaultPath = QString("%1/Default").arg(mimePath);
             if (QFileInfo::exists(defaultPath)) {
                 QString defaultApp = QFileInfo(defaultPath).symLinkTarget();
@@ -789,32 +840,62 @@ int Launcher::open(QStringList args)
             QStringList appCandidates;
             QStringList fallbackAppCandidates; // Those where only the first part of
                                                // the MIME type before the "/" matches
-            const QStringList allApps = db->allApplications();
-            for (const QString &app : allApps) {
-
-                QStringList canOpens;
-                if (db->filesystemSupportsExtattr) {
-                    bool ok = false;
-                    canOpens = Fm::getAttributeValueQString(app, "can-open", ok).split(";");
-                    if (!ok) {
-                        if (!removalCandidates.contains(app))
-                            removalCandidates.append(app);
-                        continue;
+            if (db->handlersForMimeType(mimeType, appCandidates, fallbackAppCandidates)) {
+                qDebug() << "Looked up applications for" << mimeType << "in the index";
+                // Deleting an application does not change the launch database, so the
+                // index may still list applications that do not exist anymore
+                for (QStringList *candidates : { &appCandidates, &fallbackAppCandidates }) {
+                    for (int i = candidates->size() - 1; i >= 0; i--) {
+                        const QString app = candidates->at(i);
+                        if (!QFileInfo::exists(app)) {
+                            candidates->removeAt(i);
+                            if (!removalCandidates.contains(app))
+                                removalCandidates.append(app);
+                        }
                     }
-                } else {
-                    canOpens = db->getCanOpenFromFile(app).split(";");
                 }
-
-                for (const QString &canOpen : canOpens) {
-                    if (canOpen == mimeType) {
-                        qDebug() << app << "can open" << canOpen;
-                        if (!appCandidates.contains(app))
-                            appCandidates.append(app);
+            } else {
+                const QStringList allApps = db->allApplications();
+                // Read the can-open attributes of all applications at once, so that
+                // the reads overlap
+                QStringList appsWithExtattrs;
+                for (const QString &app : allApps) {
+                    if (db->filesystemSupportsExtattr(app)) {
+                        appsWithExtattrs.append(app);
+                    }
+                }
+                const QVector<QHash<QString, QString>> allAttributes =
+                        Fm::getAttributeValues(appsWithExtattrs, { "can-open" });
+                int withExtattrs = 0;
+                for (const QString &app : allApps) {
+
+                    QStringList canOpens;
+                    if (withExtattrs < appsWithExtattrs.size()
+                        && appsWithExtattrs.at(withExtattrs) == app) {
+                        const QHash<QString, QString> &attributes =
+                                allAttributes.at(withExtattrs++);
+                        canOpens = attributes.value("can-open").split(";");
+                        if (!attributes.contains("can-open")) {
+                            // Handling the application again sets the attribute if it can
+                            if (!removalCandidates.contains(app))
+                                removalCandidates.append(app);
+                            canOpens = db->getCanOpenFromFile(app).split(";");
+                        }
+                    } else {
+                        canOpens = db->getCanOpenFromFile(app).split(";");
                     }
-                    if (canOpen.split("/").first() == mimeType.split("/").first()) {
-                        qDebug() << app << "can open" << canOpen.split("/").first();
-                        if (!fallbackAppCandidates.contains(app))
-                            fallbackAppCandidates.append(app);
+
+                    for (const QString &canOpen : canOpens) {
+                        if (canOpen == mimeType) {
+                            qDebug() << app << "can open" << canOpen;
+                            if (!appCandidates.contains(app))
+                                appCandidates.append(app);
+                        }
+                        if (canOpen.split("/").first() == mimeType.split("/").first()) {
+                            qDebug() << app << "can open" << canOpen.split("/").first();
+                            if (!fallbackAppCandidates.contains(app))
+                                fallbackAppCandidates.append(app);
+                        }
                     }
                 }
             }
@@ -836,13 +917,17 @@ int Launcher::open(QStringList args)
             }
 
             if (showChooserRequested || appCandidates.length() < 1) {
+                GuiApplication::ensure();
                 ApplicationSelectionDialog *dlg =
                         new ApplicationSelectionDialog(&fileOrProtocol, &mimeType, true, false, nullptr);
                 auto result = dlg->exec();
-                if (result == QDialog::Accepted)
+                if (result == QDialog::Accepted) {
                     appToBeLaunched = dlg->getSelectedApplication();
-                else
+                } else {
+                    db->handleApplications(removalCandidates);
+                    db->collectGarbageIfDue();
                     exit(0);
+                }
             } else {
                 appToBeLaunched = appCandidates[0];
             }
@@ -851,9 +936,7 @@ int Launcher::open(QStringList args)
     }
     // Garbage collect launch.db: Remove applications that are no longer on the
     // filesystem
-    for (const QString removalCandidate : removalCandidates) {
-        db->handleApplication(removalCandidate);
-    }
+    db->handleApplications(removalCandidates);
 
     // TODO: Prioritize which of the applications that can handle this
     // file should get to open it. For now we ust just the first one we find
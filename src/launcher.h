@@ -33,32 +33,21 @@
 #include "AppDiscovery.h"
 #include "extattrs.h"
 
-class QDetachableProcess : public QProcess
-
-{
-public:
-    QDetachableProcess(QObject *parent = 0) : QProcess(parent) { }
-    void detach()
-    {
-        this->waitForStarted();
-        setProcessState(QProcess::NotRunning);
-        // qDebug() << "Detaching process";
-    }
-};
-
 class Launcher
 {
 public:
     Launcher();
     ~Launcher();
 
-    void discoverApplications();
+    void discoverApplications(bool fullRescan = false);
     int launch(QStringList args);
     int open(const QStringList args);
+    QString bundleForName(const QString &name);
+    DbManager *database() const;
 
 private:
     DbManager *db;
-    void handleError(QDetachableProcess *p, QString errorString);
+    void handleError(const QString &program, QString errorString);
     QString getPackageUpdateCommand(QString pathToInstalledFile);
     QStringList executableForBundleOrExecutablePath(QString bundleOrExecutablePath);
     QString pathWithoutBundleSuffix(QString path);
@@ -23,6 +23,67 @@ private slots:
         QVERIFY(!Executable::hasShebangOrIsElf("/etc/os-release"));
     }
 
+    void testClassify() {
+        FileKind env = Executable::classify("/usr/bin/env");
+        QVERIFY(env.isElf);
+        QVERIFY(!env.hasShebang);
+
+        QTemporaryFile script;
+        QVERIFY(script.open());
+        script.write("#!/bin/sh\necho hello\n");
+        script.close();
+        QVERIFY(Executable::classify(script.fileName()).hasShebang);
+        QVERIFY(Executable::hasShebang(script.fileName()));
+
+        // A raw disk image that happens to start with "#!" is not a script
+        QTemporaryFile diskImage;
+        QVERIFY(diskImage.open());
+        QByteArray mbr(512, '\0');
+        mbr.replace(0, 2, "#!");
+        mbr[510] = char(0x55);
+        mbr[511] = char(0xaa);
+        diskImage.write(mbr);
+        diskImage.close();
+        QVERIFY(Executable::classify(diskImage.fileName()).isDiskImage);
+        QVERIFY(!Executable::hasShebang(diskImage.fileName()));
+
+        // The header of a type 2 AppImage with its program headers beyond the bytes read
+        QTemporaryFile appImage;
+        QVERIFY(appImage.open());
+        QByteArray elf(64, '\0');
+        elf.replace(0, 4, "\x7f" "ELF");
+        elf[4] = 2; // ELFCLASS64
+        elf[5] = 1; // ELFDATA2LSB
+        elf.replace(8, 3, QByteArray("AI\x02", 3));
+        elf[16] = 3; // ET_DYN
+        elf[33] = 0x10; // e_phoff = 4096
+        appImage.write(elf);
+        appImage.close();
+        FileKind kind = Executable::classify(appImage.fileName());
+        QVERIFY(kind.isElf);
+        QCOMPARE(kind.elfType, quint16(3));
+        QCOMPARE(kind.appImageType, 2);
+        QVERIFY(!kind.programHeadersRead);
+        QVERIFY(Executable::isElf(appImage.fileName()));
+
+        // A program header offset that wraps around when the size of the headers is added
+        QTemporaryFile hugeOffset;
+        QVERIFY(hugeOffset.open());
+        QByteArray crafted = elf;
+        crafted.replace(8, 3, QByteArray(3, '\0'));
+        crafted.replace(32, 8, QByteArray(8, char(0xff))); // e_phoff = 2^64 - 1
+        crafted[54] = 56; // e_phentsize
+        crafted[56] = 1; // e_phnum
+        hugeOffset.write(crafted);
+        hugeOffset.close();
+        kind = Executable::classify(hugeOffset.fileName());
+        QVERIFY(kind.isElf);
+        QVERIFY(!kind.programHeadersRead);
+        QVERIFY(!kind.hasInterpreter);
+
+        QVERIFY(!Executable::classify("/nonexistent").exists);
+    }
+
  };
 
 QTEST_APPLESS_MAIN(TestExecutable)